@@ -0,0 +1,648 @@
+// batch.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+#include "batch.h"
+
+// Workers share the manifest and stdout, each takes the next line when it is free
+#ifdef _OPENMP
+#define PARALLEL_WORKERS _Pragma("omp parallel reduction(+ : failures)")
+#define MANIFEST_SECTION _Pragma("omp critical(batchManifest)")
+#define OUTPUT_SECTION _Pragma("omp critical(batchOutput)")
+#else
+#define PARALLEL_WORKERS
+#define MANIFEST_SECTION
+#define OUTPUT_SECTION
+#endif
+
+// Threads building starts take the next one when they are free and share the best tour
+#ifdef _OPENMP
+#include <omp.h>
+#define PARALLEL_STARTS _Pragma("omp parallel")
+#define TEAM_SECTION _Pragma("omp single")
+#define STARTS_LOOP _Pragma("omp for schedule(dynamic, 1)")
+#define BEST_SECTION _Pragma("omp critical(startBest)")
+#define COUNTS_SECTION _Pragma("omp critical(startCounts)")
+#define THREAD_NUM omp_get_thread_num()
+#define NUM_THREADS omp_get_num_threads()
+#else
+#define PARALLEL_STARTS
+#define TEAM_SECTION
+#define STARTS_LOOP
+#define BEST_SECTION
+#define COUNTS_SECTION
+#define THREAD_NUM 0
+#define NUM_THREADS 1
+#endif
+
+// Read the next manifest line into line. Returns 1 for a line, 0 at the end of the
+// manifest and -1 for a line too long for the buffer, which is skipped.
+static int readManifestLine(FILE* manifest, char* line) {
+    int status = 1;
+    MANIFEST_SECTION
+    {
+        if (!fgets(line, BATCH_LINE_MAX, manifest)) {
+            status = 0;
+        } else if (!strchr(line, '\n') && !feof(manifest)) {
+            int c;
+            while ((c = fgetc(manifest)) != EOF && c != '\n') {
+            }
+            status = -1;
+        }
+    }
+    return status;
+}
+
+// Split line in place into at most maxWords blank-separated words, returns how many it held
+static int splitWords(char* line, char* words[], int maxWords) {
+    int count = 0;
+    char* p = line;
+    while (1) {
+        while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') {
+            p++;
+        }
+        if (*p == '\0') {
+            return count;
+        }
+        if (count == maxWords) {
+            return count + 1;
+        }
+        words[count++] = p;
+        while (*p != '\0' && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n') {
+            p++;
+        }
+        if (*p != '\0') {
+            *p++ = '\0';
+        }
+    }
+}
+
+// Load, prepare and solve one instance with a worker's problem and workspace
+static int solveInstance(TspProblem* problem, const char* inputFilename, const char* outputFilename,
+                         const TspOptions* options, BatchSolver solve, void* workspace) {
+    startPhases();
+    if (loadCoordinates(problem, inputFilename) != 0) {
+        return -1;
+    }
+    endPhase("read");
+    if (prepareDistances(problem, options) != 0) {
+        return -1;
+    }
+    endPhase("distances");
+    return solve(problem, outputFilename, workspace);
+}
+
+int runBatch(const char* manifestFilename, const TspOptions* options, BatchSolver solve,
+             size_t workspaceSize, BatchWorkspaceRelease release) {
+    int fromStdin = strcmp(manifestFilename, "-") == 0;
+    FILE* manifest = fromStdin ? stdin : fopen(manifestFilename, "r");
+    if (!manifest) {
+        perror("Error opening manifest");
+        return -1;
+    }
+
+    int failures = 0;
+    PARALLEL_WORKERS
+    {
+        // Everything an instance needs is owned by its worker and reused
+        char line[BATCH_LINE_MAX];
+        TspProblem* problem = calloc(1, sizeof(TspProblem));
+        void* workspace = calloc(1, workspaceSize);
+        if (!problem || !workspace) {
+            perror("Memory allocation for batch worker failed");
+            failures++;
+        }
+
+        int status;
+        while (problem && workspace && (status = readManifestLine(manifest, line)) != 0) {
+            if (status < 0) {
+                fprintf(stderr, "Error: manifest line longer than %d bytes\n", BATCH_LINE_MAX - 1);
+                failures++;
+                continue;
+            }
+            char* words[2];
+            int numWords = splitWords(line, words, 2);
+            if (numWords == 0 || words[0][0] == '#') {
+                continue;
+            }
+            if (numWords != 2) {
+                fprintf(stderr, "Error: manifest line starting \"%s\" does not name an input and an output file\n", words[0]);
+                failures++;
+                continue;
+            }
+
+            double start = wallTime();
+            int solved = solveInstance(problem, words[0], words[1], options, solve, workspace) == 0;
+            double seconds = wallTime() - start;
+            failures += !solved;
+            OUTPUT_SECTION
+            {
+                printf("%s %s %s %.6f\n", words[0], words[1], solved ? "ok" : "failed", seconds);
+                fflush(stdout);
+            }
+        }
+
+        if (workspace) {
+            release(workspace);
+        }
+        free(workspace);
+        freeProblem(problem);
+    }
+
+    if (!fromStdin) {
+        fclose(manifest);
+    }
+    return failures;
+}
+
+// Room in the team for numThreads workspaces and tours of numOfCoords vertices, 0 on
+// success and -1 on failure. New workspaces are zeroed, the solver grows them itself.
+static int reserveStartTeam(StartTeam* team, int numThreads, size_t workspaceSize, int numOfCoords) {
+    int grown = 0;
+    if (numThreads > team->numThreads) {
+        char* workspaces = realloc(team->workspaces, numThreads * workspaceSize);
+        if (!workspaces) {
+            perror("Memory allocation for start workspaces failed");
+            return -1;
+        }
+        memset(workspaces + team->numThreads * workspaceSize, 0, (numThreads - team->numThreads) * workspaceSize);
+        team->workspaces = workspaces;
+        team->numThreads = numThreads;
+        team->workspaceSize = workspaceSize;
+        grown = 1;
+    }
+    if (grown || numOfCoords > team->capacity) {
+        int capacity = numOfCoords > team->capacity ? numOfCoords : team->capacity;
+        free(team->orders);
+        team->orders = malloc((size_t)team->numThreads * capacity * sizeof(int));
+        team->capacity = team->orders ? capacity : 0;
+        if (!team->orders) {
+            perror("Memory allocation for start tours failed");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int runStarts(const TspProblem* problem, StartTeam* team, size_t workspaceSize, StartBuilder build, TspTour* best) {
+    int numOfCoords = problem->numOfCoords;
+    int numStarts = problem->options.numStarts < numOfCoords ? problem->options.numStarts : numOfCoords;
+    double deadline = problem->options.startTimeLimit > 0.0 ? wallTime() + problem->options.startTimeLimit : DBL_MAX;
+    double bestLength = DBL_MAX;
+    int bestStart = -1; // index of the start the best tour came from
+    int failed = 0;
+    long counts[COUNT_KINDS] = { 0 }; // of the threads other than the caller
+
+    PARALLEL_STARTS
+    {
+        int thread = THREAD_NUM;
+        TEAM_SECTION
+        {
+            failed = reserveStartTeam(team, NUM_THREADS, workspaceSize, numOfCoords) != 0;
+        }
+        int ok = !failed;
+        void* workspace = ok ? team->workspaces + thread * workspaceSize : NULL;
+        int* order = ok ? team->orders + (size_t)thread * team->capacity : NULL;
+        if (thread > 0) {
+            memset(phaseCounts, 0, sizeof(phaseCounts));
+        }
+
+        STARTS_LOOP
+        for (int s = 0; s < numStarts; s++) {
+            if (!ok || (s > 0 && wallTime() > deadline)) {
+                continue;
+            }
+            // Start 0 is vertex 0, so a single start is the plain construction
+            int start = (int)((long long)s * numOfCoords / numStarts);
+            TspTour* tour;
+            int status = build(problem, start, s == 0 ? DBL_MAX : deadline, workspace, &tour);
+            if (status != 0) {
+                if (status < 0) {
+                    ok = 0;
+                    BEST_SECTION
+                    {
+                        failed = 1;
+                    }
+                }
+                continue;
+            }
+            addCount(COUNT_STARTS, 1);
+            tourToArray(tour, order);
+            double length = tourLength(problem, order);
+            BEST_SECTION
+            {
+                // The first tour finished is kept even when lengths overflow to inf
+                if (bestStart < 0 || length < bestLength || (length == bestLength && s < bestStart)) {
+                    copyTour(best, tour, numOfCoords);
+                    bestLength = length;
+                    bestStart = s;
+                }
+            }
+        }
+
+        if (thread > 0) {
+            COUNTS_SECTION
+            {
+                for (int c = 0; c < COUNT_KINDS; c++) {
+                    counts[c] += phaseCounts[c];
+                }
+            }
+        }
+    }
+
+    for (int c = 0; c < COUNT_KINDS; c++) {
+        addCount(c, counts[c]);
+    }
+    if (failed || bestStart < 0) {
+        return -1;
+    }
+    return (int)((long long)bestStart * numOfCoords / numStarts);
+}
+
+void releaseStartTeam(StartTeam* team, BatchWorkspaceRelease release) {
+    for (int t = 0; t < team->numThreads; t++) {
+        release(team->workspaces + t * team->workspaceSize);
+    }
+    free(team->workspaces);
+    free(team->orders);
+    memset(team, 0, sizeof(StartTeam));
+}
+
+#define STITCH_WINDOW 24 // tour positions on each side of a seam the repair may reorder
+#define REPAIR_EPSILON 1e-10 // relative gain a repair needs, so rounding never cycles
+#define REPAIR_PASSES 64 // passes over a seam's window at most
+
+// Threads building partitions take the next one when they are free
+#ifdef _OPENMP
+#define PARALLEL_PARTITIONS _Pragma("omp parallel")
+#define PARTITIONS_LOOP _Pragma("omp for schedule(dynamic, 1)")
+#define FAILED_SECTION _Pragma("omp critical(partitionFailed)")
+#define PART_COUNTS_SECTION _Pragma("omp critical(partitionCounts)")
+#else
+#define PARALLEL_PARTITIONS
+#define PARTITIONS_LOOP
+#define FAILED_SECTION
+#define PART_COUNTS_SECTION
+#endif
+
+// Room in the team for numThreads workspaces and problems, partitions of partSize
+// vertices and a problem of numOfCoords, 0 on success and -1 on failure. New
+// workspaces are zeroed, the solver grows them itself.
+static int reservePartitionTeam(PartitionTeam* team, int numThreads, size_t workspaceSize, int partSize, int numOfCoords) {
+    if (numThreads > team->numThreads) {
+        char* workspaces = realloc(team->workspaces, numThreads * workspaceSize);
+        if (workspaces) {
+            memset(workspaces + team->numThreads * workspaceSize, 0, (numThreads - team->numThreads) * workspaceSize);
+            team->workspaces = workspaces;
+        }
+        TspProblem** problems = workspaces ? realloc(team->problems, numThreads * sizeof(TspProblem*)) : NULL;
+        if (problems) {
+            team->problems = problems;
+        }
+        // Threads join one at a time, so a failure leaves the team releasable
+        while (problems && team->numThreads < numThreads) {
+            problems[team->numThreads] = calloc(1, sizeof(TspProblem));
+            if (!problems[team->numThreads]) {
+                break;
+            }
+            team->numThreads++;
+        }
+        team->workspaceSize = workspaceSize;
+        team->partCapacity = 0;
+        if (team->numThreads < numThreads) {
+            perror("Memory allocation for partition workspaces failed");
+            return -1;
+        }
+    }
+    if (partSize > team->partCapacity) {
+        free(team->orders);
+        team->orders = malloc((size_t)team->numThreads * 2 * partSize * sizeof(int));
+        team->partCapacity = team->orders ? partSize : 0;
+        if (!team->orders) {
+            perror("Memory allocation for partition tours failed");
+            return -1;
+        }
+    }
+    if (!team->centroids) {
+        team->centroids = calloc(1, sizeof(TspProblem));
+    }
+    if (numOfCoords > team->capacity) {
+        free(team->members);
+        free(team->partStart);
+        free(team->partOrder);
+        free(team->order);
+        team->members = malloc(numOfCoords * sizeof(int));
+        team->partStart = malloc((numOfCoords + 1) * sizeof(int));
+        team->partOrder = malloc(numOfCoords * sizeof(int));
+        team->order = malloc(numOfCoords * sizeof(int));
+        team->capacity = numOfCoords;
+    }
+    if (!team->centroids || !team->members || !team->partStart || !team->partOrder || !team->order) {
+        perror("Memory allocation for partitions failed");
+        team->capacity = 0;
+        return -1;
+    }
+    return 0;
+}
+
+// Reorder members[lo .. hi) so the vertex at mid is the one a sort by coordinate puts
+// there, with none after it smaller and none before it larger
+static void selectMedian(const double* coord, int* members, int lo, int hi, int mid) {
+    while (hi - lo > 1) {
+        double pivot = coord[members[lo + (hi - lo) / 2]];
+        int i = lo;
+        int j = hi - 1;
+        while (i <= j) {
+            while (coord[members[i]] < pivot) {
+                i++;
+            }
+            while (coord[members[j]] > pivot) {
+                j--;
+            }
+            if (i <= j) {
+                int swap = members[i];
+                members[i++] = members[j];
+                members[j--] = swap;
+            }
+        }
+        // members[lo .. j] are at most the pivot, members[i .. hi) at least
+        if (mid <= j) {
+            hi = j + 1;
+        } else if (mid >= i) {
+            lo = i;
+        } else {
+            return;
+        }
+    }
+}
+
+// Split members[lo .. hi) at the median of its longer side until no part holds more
+// than maxSize vertices, appending the end of each part to partStart
+static void bisect(const TspProblem* problem, int* members, int lo, int hi, int maxSize, int* partStart, int* numParts) {
+    if (hi - lo <= maxSize) {
+        partStart[++*numParts] = hi;
+        return;
+    }
+    double minX = problem->x[members[lo]], maxX = minX;
+    double minY = problem->y[members[lo]], maxY = minY;
+    for (int i = lo + 1; i < hi; i++) {
+        double x = problem->x[members[i]];
+        double y = problem->y[members[i]];
+        minX = x < minX ? x : minX;
+        maxX = x > maxX ? x : maxX;
+        minY = y < minY ? y : minY;
+        maxY = y > maxY ? y : maxY;
+    }
+    const double* coord = halfSpan(minX, maxX) >= halfSpan(minY, maxY) ? problem->x : problem->y;
+    int mid = lo + (hi - lo) / 2;
+    selectMedian(coord, members, lo, hi, mid);
+    bisect(problem, members, lo, mid, maxSize, partStart, numParts);
+    bisect(problem, members, mid, hi, maxSize, partStart, numParts);
+}
+
+// Build the tour of partition p with a thread's problem and workspace and leave its
+// vertices in members in tour order, 0 on success and -1 on failure
+static int buildPartition(const TspProblem* problem, PartitionTeam* team, int p, int thread, StartBuilder build) {
+    int first = team->partStart[p];
+    int count = team->partStart[p + 1] - first;
+    int* members = team->members + first;
+    TspProblem* part = team->problems[thread];
+    if (resetCoordinates(part, count) != 0) {
+        return -1;
+    }
+    for (int i = 0; i < count; i++) {
+        part->x[i] = problem->x[members[i]];
+        part->y[i] = problem->y[members[i]];
+    }
+
+    // A part is solved whole, on one thread, with the problem's distance options
+    TspOptions options = problem->options;
+    options.hilbertOrder = 0;
+    options.partitionSize = 0;
+    if (prepareDistances(part, &options) != 0) {
+        return -1;
+    }
+    TspTour* tour;
+    if (build(part, 0, DBL_MAX, team->workspaces + thread * team->workspaceSize, &tour) != 0) {
+        return -1;
+    }
+
+    int* local = team->orders + (size_t)thread * 2 * team->partCapacity;
+    int* global = local + team->partCapacity;
+    tourToArray(tour, local);
+    for (int i = 0; i < count; i++) {
+        global[i] = members[local[i]];
+    }
+    memcpy(members, global, count * sizeof(int));
+    return 0;
+}
+
+// Build a tour over the centroids of the numParts partitions with the first thread's
+// workspace and put the partitions in its order, 0 on success and -1 on failure
+static int orderPartitions(const TspProblem* problem, PartitionTeam* team, int numParts, StartBuilder build) {
+    TspProblem* centroids = team->centroids;
+    if (resetCoordinates(centroids, numParts) != 0) {
+        return -1;
+    }
+    for (int p = 0; p < numParts; p++) {
+        double sumX = 0.0;
+        double sumY = 0.0;
+        for (int i = team->partStart[p]; i < team->partStart[p + 1]; i++) {
+            sumX += problem->x[team->members[i]];
+            sumY += problem->y[team->members[i]];
+        }
+        int count = team->partStart[p + 1] - team->partStart[p];
+        centroids->x[p] = sumX / count;
+        centroids->y[p] = sumY / count;
+    }
+
+    // There can be as many partitions as vertices, so no table is built for them
+    TspOptions options = problem->options;
+    options.distanceMode = DISTANCES_NONE;
+    options.useFloat = 0;
+    options.hilbertOrder = 0;
+    options.partitionSize = 0;
+    TspTour* tour;
+    if (prepareDistances(centroids, &options) != 0 ||
+        build(centroids, 0, DBL_MAX, team->workspaces, &tour) != 0) {
+        return -1;
+    }
+    tourToArray(tour, team->partOrder);
+    return 0;
+}
+
+// Join the partitions' tours in partOrder into the team's order. Each is cut at the
+// edge, and run in the direction, that is cheapest to reach from the end of the tour
+// so far and to leave towards the next partition's centroid. Leaves the position of
+// each partition's first vertex in partOrder.
+static void stitchPartitions(const TspProblem* problem, PartitionTeam* team, int numParts) {
+    const double* x = problem->x;
+    const double* y = problem->y;
+    DistanceMetric metric = problem->metric;
+    int* partOrder = team->partOrder;
+    int* order = team->order;
+    double fromX = team->centroids->x[partOrder[numParts - 1]];
+    double fromY = team->centroids->y[partOrder[numParts - 1]];
+    int position = 0;
+    for (int k = 0; k < numParts; k++) {
+        int p = partOrder[k];
+        const int* cycle = team->members + team->partStart[p];
+        int count = team->partStart[p + 1] - team->partStart[p];
+        // The last partition heads back to the first vertex of the tour
+        double toX = k + 1 < numParts ? team->centroids->x[partOrder[k + 1]] : x[order[0]];
+        double toY = k + 1 < numParts ? team->centroids->y[partOrder[k + 1]] : y[order[0]];
+
+        // Cutting (u, v) leaves a path from v forwards to u, or from u backwards to v
+        double bestCost = DBL_MAX;
+        int bestCut = 0;
+        int backward = 0;
+        for (int t = 0; t < count; t++) {
+            int u = cycle[t];
+            int v = cycle[(t + 1) % count];
+            double edge = coordinateDistance(problem, u, v);
+            double forwardCost = pointDistance(metric, fromX, fromY, x[v], y[v]) + pointDistance(metric, x[u], y[u], toX, toY) - edge;
+            double backwardCost = pointDistance(metric, fromX, fromY, x[u], y[u]) + pointDistance(metric, x[v], y[v], toX, toY) - edge;
+            if (forwardCost < bestCost) {
+                bestCost = forwardCost;
+                bestCut = t;
+                backward = 0;
+            }
+            if (backwardCost < bestCost) {
+                bestCost = backwardCost;
+                bestCut = t;
+                backward = 1;
+            }
+        }
+
+        partOrder[k] = position;
+        for (int t = 0; t < count; t++) {
+            order[position++] = backward ? cycle[(bestCut - t + count) % count] : cycle[(bestCut + 1 + t) % count];
+        }
+        fromX = x[order[position - 1]];
+        fromY = y[order[position - 1]];
+    }
+}
+
+// 2-opt the tour over the positions within window of the seam between positions
+// seam - 1 and seam, counted around the cycle, until no move in the window gains or
+// REPAIR_PASSES passes are made. Returns the moves made.
+static long repairSeam(const TspProblem* problem, int* order, int numOfCoords, int seam, int window) {
+    long moves = 0;
+    int improved = 1;
+    for (int pass = 0; improved && pass < REPAIR_PASSES; pass++) {
+        improved = 0;
+        // Edge a joins the positions seam + a and seam + a + 1
+        for (int a = -window; a < window - 2; a++) {
+            for (int b = a + 2; b < window; b++) {
+                int i = (seam + a + numOfCoords) % numOfCoords;
+                int j = (seam + b + numOfCoords) % numOfCoords;
+                int p = order[i];
+                int q = order[(i + 1) % numOfCoords];
+                int r = order[j];
+                int s = order[(j + 1) % numOfCoords];
+                double removed = getDistance(problem, p, q) + getDistance(problem, r, s);
+                double gain = removed - getDistance(problem, p, r) - getDistance(problem, q, s);
+                // Written to reject a NaN gain too, which overflowing distances give
+                if (!(gain > REPAIR_EPSILON * removed)) {
+                    continue;
+                }
+                // Reverse the positions from q to r
+                for (int lo = seam + a + 1, hi = seam + b; lo < hi; lo++, hi--) {
+                    int l = (lo + numOfCoords) % numOfCoords;
+                    int h = (hi + numOfCoords) % numOfCoords;
+                    int swap = order[l];
+                    order[l] = order[h];
+                    order[h] = swap;
+                }
+                moves++;
+                improved = 1;
+            }
+        }
+    }
+    return moves;
+}
+
+int runPartitions(const TspProblem* problem, PartitionTeam* team, size_t workspaceSize, StartBuilder build, TspTour* tour) {
+    int numOfCoords = problem->numOfCoords;
+    int partSize = problem->options.partitionSize < numOfCoords ? problem->options.partitionSize : numOfCoords;
+    int numParts = 0;
+    int failed = 0;
+    long counts[COUNT_KINDS] = { 0 }; // of the threads other than the caller
+
+    PARALLEL_PARTITIONS
+    {
+        int thread = THREAD_NUM;
+        TEAM_SECTION
+        {
+            failed = reservePartitionTeam(team, NUM_THREADS, workspaceSize, partSize, numOfCoords) != 0;
+            if (!failed) {
+                for (int v = 0; v < numOfCoords; v++) {
+                    team->members[v] = v;
+                }
+                team->partStart[0] = 0;
+                bisect(problem, team->members, 0, numOfCoords, partSize, team->partStart, &numParts);
+            }
+        }
+        if (thread > 0) {
+            memset(phaseCounts, 0, sizeof(phaseCounts));
+        }
+
+        PARTITIONS_LOOP
+        for (int p = 0; p < numParts; p++) {
+            if (!failed && buildPartition(problem, team, p, thread, build) != 0) {
+                FAILED_SECTION
+                {
+                    failed = 1;
+                }
+            }
+        }
+
+        if (thread > 0) {
+            PART_COUNTS_SECTION
+            {
+                for (int c = 0; c < COUNT_KINDS; c++) {
+                    counts[c] += phaseCounts[c];
+                }
+            }
+        }
+    }
+
+    for (int c = 0; c < COUNT_KINDS; c++) {
+        addCount(c, counts[c]);
+    }
+    if (failed || orderPartitions(problem, team, numParts, build) != 0) {
+        return -1;
+    }
+    stitchPartitions(problem, team, numParts);
+
+    // Windows wider than the tour would reverse across themselves
+    int window = STITCH_WINDOW < (numOfCoords - 1) / 2 ? STITCH_WINDOW : (numOfCoords - 1) / 2;
+    long moves = 0;
+    for (int k = 0; k < numParts; k++) {
+        moves += repairSeam(problem, team->order, numOfCoords, team->partOrder[k], window);
+    }
+    addCount(COUNT_MOVES, moves);
+    setTourOrder(tour, team->order, numOfCoords);
+    return 0;
+}
+
+void releasePartitionTeam(PartitionTeam* team, BatchWorkspaceRelease release) {
+    for (int t = 0; t < team->numThreads; t++) {
+        if (team->workspaces) {
+            release(team->workspaces + t * team->workspaceSize);
+        }
+        if (team->problems) {
+            freeProblem(team->problems[t]);
+        }
+    }
+    free(team->workspaces);
+    free(team->problems);
+    free(team->orders);
+    freeProblem(team->centroids);
+    free(team->members);
+    free(team->partStart);
+    free(team->partOrder);
+    free(team->order);
+    memset(team, 0, sizeof(PartitionTeam));
+}
@@ -0,0 +1,93 @@
+// batch.h
+// Batch mode of the solvers: many instances per process, one per worker,
+// multi-start construction: many tours per instance, one per thread at a time, and
+// partitioned construction: one tour per part of an instance, stitched together.
+// Build it into the solver with -fopenmp for a worker per thread, e.g.
+// gcc -fopenmp fInsertion.c farthestInsertion.c batch.c tspProblem.c tspTour.c twoLevelList.c localSearch.c -o fInsertion -lm
+// Without OpenMP the instances and the starts are run one after another.
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stddef.h>
+#include "tspProblem.h"
+#include "tspTour.h"
+
+#define BATCH_LINE_MAX 8192 // longest manifest line, two file names
+
+// Solve one prepared problem and write its tour, 0 on success and -1 on failure.
+// The workspace belongs to the calling worker and keeps its buffers between instances.
+typedef int (*BatchSolver)(const TspProblem* problem, const char* outputFilename, void* workspace);
+
+// Release the buffers a solver left in a workspace
+typedef void (*BatchWorkspaceRelease)(void* workspace);
+
+// Solve every "<coordinate_file_name> <output_file_name>" line of the manifest, or of
+// stdin when it is "-", as the lines arrive. Blank lines and lines starting with '#'
+// are skipped. Each worker owns a zeroed workspace of workspaceSize bytes and a
+// problem it reloads, so after its largest instance it allocates nothing more. A line
+// "<coordinate_file_name> <output_file_name> ok|failed <seconds>" is printed on stdout
+// as each instance completes. Returns the number of failed instances, -1 if the
+// manifest cannot be opened.
+int runBatch(const char* manifestFilename, const TspOptions* options, BatchSolver solve,
+             size_t workspaceSize, BatchWorkspaceRelease release);
+
+// Build a tour from vertex start with a workspace's buffers and point *tour at it:
+// 0 when it is built, 1 when the deadline passed first and -1 on failure
+typedef int (*StartBuilder)(const TspProblem* problem, int start, double deadline, void* workspace, TspTour** tour);
+
+// Workspaces of the threads building starts, kept between the instances of a batch.
+// A zeroed team is empty.
+typedef struct {
+    int numThreads; // workspaces allocated
+    size_t workspaceSize;
+    char* workspaces; // a zeroed solver workspace per thread at first
+    int* orders; // room for a tour of capacity vertices per thread
+    int capacity;
+} StartTeam;
+
+// Build tours from problem->options.numStarts start vertices spread over the ids,
+// sharing the problem's read-only tables between the threads, and copy the shortest
+// into best. Ties go to the earlier start, so only the start time limit makes the
+// result depend on the threads. With the time limit no start begins after it and
+// unfinished ones are dropped, but the tour from vertex 0 is always finished.
+// Returns the start vertex of the tour kept, -1 on failure.
+int runStarts(const TspProblem* problem, StartTeam* team, size_t workspaceSize, StartBuilder build, TspTour* best);
+
+// Release the team's workspaces with the solver's release function
+void releaseStartTeam(StartTeam* team, BatchWorkspaceRelease release);
+
+// Workspaces and problems of the threads building the tours of partitions, and the
+// partitioning itself, kept between the instances of a batch. A zeroed team is empty.
+typedef struct {
+    int numThreads; // workspaces and problems allocated
+    size_t workspaceSize;
+    char* workspaces; // a zeroed solver workspace per thread at first
+    TspProblem** problems; // the partition each thread solves, reloaded for every one
+    int* orders; // room for two tours of partCapacity vertices per thread
+    int partCapacity;
+    TspProblem* centroids; // a vertex per partition, whose tour orders the partitions
+    int* members; // vertices of each partition, in its tour order once it is built
+    int* partStart; // partition p holds members[partStart[p] .. partStart[p + 1])
+    int* partOrder; // partitions in the order they are stitched
+    int* order; // the stitched tour
+    int capacity; // vertices members and order hold, partitions the others hold
+} PartitionTeam;
+
+// Split the problem into partitions of at most problem->options.partitionSize vertices
+// by recursive bisection at the median of the longer side, build a tour of each from
+// its first vertex with the threads sharing the work, and stitch the tours into one.
+// Each tour is cut at the edge that joins it best to the one before and the next
+// partition, and the tour is then 2-opted in a short window around every seam.
+// The partitions are visited in the order of a tour built over their centroids.
+// The result is deterministic whatever the team size. 0 on success and -1 on failure.
+int runPartitions(const TspProblem* problem, PartitionTeam* team, size_t workspaceSize, StartBuilder build, TspTour* tour);
+
+// Whether a problem is built in partitions
+static inline int partitioned(const TspProblem* problem) {
+    return problem->options.partitionSize > 0 && problem->numOfCoords > problem->options.partitionSize;
+}
+
+// Release the team's workspaces with the solver's release function, and its problems
+void releasePartitionTeam(PartitionTeam* team, BatchWorkspaceRelease release);
+
+#endif
@@ -0,0 +1,390 @@
+// benchmark.c
+// Runs the solvers on generated inputs and reports per-phase wall time, peak RSS
+// and tour cost as CSV or JSON. Build the solvers first, then
+// gcc benchmark.c tspProblem.c tspTour.c -o benchmark -lm
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include "tspProblem.h"
+#include "tspTour.h"
+
+#define MAX_LIST 32 // Entries accepted in each comma-separated option
+#define MAX_SOLVER_ARGS 16 // Extra arguments passed through to every solver
+#define COORD_RANGE 10000.0 // Generated coordinates lie in [0, COORD_RANGE)
+
+typedef enum {
+    UNIFORM,
+    CLUSTERED,
+    GRID
+} Distribution;
+
+static const char* distributionNames[] = { "uniform", "clustered", "grid" };
+
+// One solver run
+typedef struct {
+    const char* solver;
+    const char* distribution;
+    int size;
+    int threads;
+    double read;
+    double distances;
+    double construction;
+    double optimization; // 0 unless the solver runs with --optimize
+    double write;
+    double total;
+    long peakRssKb;
+    double tourCost;
+    int status; // exit status of the solver, -1 when it did not exit normally
+} BenchmarkResult;
+
+// Function prototypes
+static int parseList(char* text, char* items[]);
+static void generateCoordinates(const char* filename, Distribution distribution, int size, uint64_t seed);
+static int runSolver(const char* solverPath, const char* inputFilename, const char* outputFilename,
+                     int threads, char* solverArgs[], int numSolverArgs, BenchmarkResult* result);
+static double tourCost(const char* inputFilename, const char* tourFilename);
+static void printResult(FILE* out, const BenchmarkResult* result, int json, int first);
+
+static void printUsage(const char* program) {
+    printf("Usage: %s [options]\n", program);
+    printf("Options:\n");
+    printf("  --solvers=LIST        solver binaries (default ./cInsertion,./fInsertion,./ompcInsertion,./ompfInsertion)\n");
+    printf("  --sizes=LIST          input sizes (default 1000,4000)\n");
+    printf("  --distributions=LIST  uniform, clustered and/or grid (default all)\n");
+    printf("  --threads=LIST        OMP_NUM_THREADS values for the omp* solvers (default 1,2,4)\n");
+    printf("  --seed=N              seed of the generated inputs (default 1)\n");
+    printf("  --format=csv|json     output format (default csv)\n");
+    printf("  --output=FILE         write results to FILE instead of stdout\n");
+    printf("  --workdir=DIR         where inputs and tours are written (default /tmp)\n");
+    printf("  --solver-arg=ARG      pass ARG to every solver, e.g. --solver-arg=--distances=packed\n");
+}
+
+int main(int argc, char* argv[]) {
+    char defaultSolvers[] = "./cInsertion,./fInsertion,./ompcInsertion,./ompfInsertion";
+    char defaultSizes[] = "1000,4000";
+    char defaultDistributions[] = "uniform,clustered,grid";
+    char defaultThreads[] = "1,2,4";
+    char* solversText = defaultSolvers;
+    char* sizesText = defaultSizes;
+    char* distributionsText = defaultDistributions;
+    char* threadsText = defaultThreads;
+    const char* outputFilename = NULL;
+    const char* workdir = "/tmp";
+    uint64_t seed = 1;
+    int json = 0;
+    char* solverArgs[MAX_SOLVER_ARGS + 1];
+    int numSolverArgs = 0;
+
+    for (int i = 1; i < argc; i++) {
+        char* value = strchr(argv[i], '=');
+        if (!value) {
+            printUsage(argv[0]);
+            return 1;
+        }
+        value++;
+        if (strncmp(argv[i], "--solvers=", 10) == 0) {
+            solversText = value;
+        } else if (strncmp(argv[i], "--sizes=", 8) == 0) {
+            sizesText = value;
+        } else if (strncmp(argv[i], "--distributions=", 16) == 0) {
+            distributionsText = value;
+        } else if (strncmp(argv[i], "--threads=", 10) == 0) {
+            threadsText = value;
+        } else if (strncmp(argv[i], "--seed=", 7) == 0) {
+            seed = strtoull(value, NULL, 10);
+        } else if (strcmp(argv[i], "--format=csv") == 0) {
+            json = 0;
+        } else if (strcmp(argv[i], "--format=json") == 0) {
+            json = 1;
+        } else if (strncmp(argv[i], "--output=", 9) == 0) {
+            outputFilename = value;
+        } else if (strncmp(argv[i], "--workdir=", 10) == 0) {
+            workdir = value;
+        } else if (strncmp(argv[i], "--solver-arg=", 13) == 0 && numSolverArgs < MAX_SOLVER_ARGS) {
+            solverArgs[numSolverArgs++] = value;
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    char* solvers[MAX_LIST];
+    char* sizes[MAX_LIST];
+    char* distributions[MAX_LIST];
+    char* threads[MAX_LIST];
+    int numSolvers = parseList(solversText, solvers);
+    int numSizes = parseList(sizesText, sizes);
+    int numDistributions = parseList(distributionsText, distributions);
+    int numThreads = parseList(threadsText, threads);
+
+    FILE* out = outputFilename ? fopen(outputFilename, "w") : stdout;
+    if (!out) {
+        perror("Error opening output file");
+        return EXIT_FAILURE;
+    }
+    if (json) {
+        fprintf(out, "[\n");
+    } else {
+        fprintf(out, "solver,distribution,size,threads,read_s,distances_s,construction_s,optimization_s,write_s,total_s,peak_rss_kb,tour_cost,status\n");
+    }
+
+    int first = 1;
+    for (int d = 0; d < numDistributions; d++) {
+        int distribution = -1;
+        for (int k = 0; k < 3; k++) {
+            if (strcmp(distributions[d], distributionNames[k]) == 0) {
+                distribution = k;
+            }
+        }
+        if (distribution < 0) {
+            fprintf(stderr, "Unknown distribution: %s\n", distributions[d]);
+            continue;
+        }
+
+        for (int z = 0; z < numSizes; z++) {
+            int size = atoi(sizes[z]);
+            if (size < 1) {
+                fprintf(stderr, "Invalid size: %s\n", sizes[z]);
+                continue;
+            }
+
+            char inputFilename[4096];
+            char outputTour[4096];
+            snprintf(inputFilename, sizeof(inputFilename), "%s/bench_%s_%d_%d.coord", workdir, distributions[d], size, (int)getpid());
+            snprintf(outputTour, sizeof(outputTour), "%s/bench_%d.tour", workdir, (int)getpid());
+            generateCoordinates(inputFilename, distribution, size, seed);
+
+            for (int s = 0; s < numSolvers; s++) {
+                // Only the OpenMP solvers are swept over thread counts
+                const char* name = strrchr(solvers[s], '/') ? strrchr(solvers[s], '/') + 1 : solvers[s];
+                int parallel = strncmp(name, "omp", 3) == 0;
+                for (int t = 0; t < (parallel ? numThreads : 1); t++) {
+                    BenchmarkResult result = { 0 };
+                    result.solver = name;
+                    result.distribution = distributions[d];
+                    result.size = size;
+                    result.threads = parallel ? atoi(threads[t]) : 1;
+                    runSolver(solvers[s], inputFilename, outputTour, result.threads, solverArgs, numSolverArgs, &result);
+                    printResult(out, &result, json, first);
+                    fflush(out);
+                    first = 0;
+                }
+            }
+
+            remove(inputFilename);
+            remove(outputTour);
+        }
+    }
+
+    if (json) {
+        fprintf(out, "\n]\n");
+    }
+    if (out != stdout) {
+        fclose(out);
+    }
+    return 0;
+}
+
+// Split a comma-separated list in place, returns the number of items
+static int parseList(char* text, char* items[]) {
+    int count = 0;
+    for (char* item = strtok(text, ","); item && count < MAX_LIST; item = strtok(NULL, ",")) {
+        items[count++] = item;
+    }
+    return count;
+}
+
+// xorshift64*, so inputs are identical across platforms for a given seed
+static uint64_t nextRandom(uint64_t* state) {
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 2685821657736338717ULL;
+}
+
+// Uniform in [0, 1)
+static double uniformRandom(uint64_t* state) {
+    return (nextRandom(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static void generateCoordinates(const char* filename, Distribution distribution, int size, uint64_t seed) {
+    FILE* file = fopen(filename, "w");
+    if (!file) {
+        perror("Error opening input file");
+        exit(EXIT_FAILURE);
+    }
+
+    uint64_t state = seed * 0x9E3779B97F4A7C15ULL + 1;
+    int side = (int)ceil(sqrt((double)size));
+
+    // Clusters of about a hundred vertices with a Gaussian spread around each centre
+    int numClusters = size / 100 > 0 ? size / 100 : 1;
+    double spread = COORD_RANGE / (4.0 * sqrt((double)numClusters));
+    double* centres = malloc(2 * numClusters * sizeof(double));
+    if (!centres) {
+        perror("Memory allocation for cluster centres failed");
+        exit(EXIT_FAILURE);
+    }
+    for (int c = 0; c < 2 * numClusters; c++) {
+        centres[c] = uniformRandom(&state) * COORD_RANGE;
+    }
+
+    for (int i = 0; i < size; i++) {
+        double x, y;
+        if (distribution == GRID) {
+            x = (i % side) * (COORD_RANGE / side);
+            y = (i / side) * (COORD_RANGE / side);
+        } else if (distribution == CLUSTERED) {
+            int c = (int)(uniformRandom(&state) * numClusters);
+            // Box-Muller
+            double r = sqrt(-2.0 * log(1.0 - uniformRandom(&state)));
+            double angle = 2.0 * M_PI * uniformRandom(&state);
+            x = centres[2 * c] + spread * r * cos(angle);
+            y = centres[2 * c + 1] + spread * r * sin(angle);
+        } else {
+            x = uniformRandom(&state) * COORD_RANGE;
+            y = uniformRandom(&state) * COORD_RANGE;
+        }
+        fprintf(file, "%.6f,%.6f\n", x, y);
+    }
+
+    free(centres);
+    fclose(file);
+}
+
+// Run one solver with --timings and collect its phases, peak RSS and tour cost
+static int runSolver(const char* solverPath, const char* inputFilename, const char* outputFilename,
+                     int threads, char* solverArgs[], int numSolverArgs, BenchmarkResult* result) {
+    int timingPipe[2];
+    if (pipe(timingPipe) != 0) {
+        perror("pipe failed");
+        result->status = -1;
+        return -1;
+    }
+
+    double start = wallTime();
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork failed");
+        close(timingPipe[0]);
+        close(timingPipe[1]);
+        result->status = -1;
+        return -1;
+    }
+
+    if (pid == 0) {
+        char threadCount[16];
+        snprintf(threadCount, sizeof(threadCount), "%d", threads);
+        setenv("OMP_NUM_THREADS", threadCount, 1);
+
+        // Timings arrive on stderr, the solvers' progress messages are dropped
+        int devNull = open("/dev/null", O_WRONLY);
+        if (devNull >= 0) {
+            dup2(devNull, STDOUT_FILENO);
+            close(devNull);
+        }
+        dup2(timingPipe[1], STDERR_FILENO);
+        close(timingPipe[0]);
+        close(timingPipe[1]);
+
+        char* args[MAX_SOLVER_ARGS + 5];
+        int n = 0;
+        args[n++] = (char*)solverPath;
+        args[n++] = (char*)inputFilename;
+        args[n++] = (char*)outputFilename;
+        for (int i = 0; i < numSolverArgs; i++) {
+            args[n++] = solverArgs[i];
+        }
+        args[n++] = "--timings";
+        args[n] = NULL;
+        execv(solverPath, args);
+        perror("execv failed");
+        _exit(127);
+    }
+
+    close(timingPipe[1]);
+    FILE* timings = fdopen(timingPipe[0], "r");
+    char line[256];
+    while (timings && fgets(line, sizeof(line), timings)) {
+        char phase[64];
+        double seconds;
+        if (sscanf(line, "phase %63s %lf", phase, &seconds) != 2) {
+            fputs(line, stderr); // Pass the solver's own errors through
+            continue;
+        }
+        if (strcmp(phase, "read") == 0) {
+            result->read = seconds;
+        } else if (strcmp(phase, "distances") == 0) {
+            result->distances = seconds;
+        } else if (strcmp(phase, "construction") == 0) {
+            result->construction = seconds;
+        } else if (strcmp(phase, "optimization") == 0) {
+            result->optimization = seconds;
+        } else if (strcmp(phase, "write") == 0) {
+            result->write = seconds;
+        }
+    }
+    if (timings) {
+        fclose(timings);
+    }
+
+    int status;
+    struct rusage usage;
+    if (wait4(pid, &status, 0, &usage) < 0) {
+        perror("wait4 failed");
+        result->status = -1;
+        return -1;
+    }
+    result->total = wallTime() - start;
+    result->peakRssKb = usage.ru_maxrss; // kilobytes on Linux
+    result->status = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+    result->tourCost = result->status == 0 ? tourCost(inputFilename, outputFilename) : NAN;
+    return result->status;
+}
+
+// Length of the closed tour in tourFilename, NAN when it is not a tour of the input
+static double tourCost(const char* inputFilename, const char* tourFilename) {
+    TspProblem* problem = readCoordinates(inputFilename);
+    if (!problem) {
+        return NAN;
+    }
+
+    double cost = NAN;
+    int* order = malloc(problem->numOfCoords * sizeof(int));
+    if (order && readTourFile(tourFilename, problem->numOfCoords, order) == 0) {
+        cost = tourLength(problem, order);
+    }
+
+    free(order);
+    freeProblem(problem);
+    return cost;
+}
+
+static void printResult(FILE* out, const BenchmarkResult* r, int json, int first) {
+    if (json) {
+        fprintf(out, "%s  {\"solver\": \"%s\", \"distribution\": \"%s\", \"size\": %d, \"threads\": %d, "
+                     "\"read_s\": %.6f, \"distances_s\": %.6f, \"construction_s\": %.6f, \"optimization_s\": %.6f, "
+                     "\"write_s\": %.6f, "
+                     "\"total_s\": %.6f, \"peak_rss_kb\": %ld, \"tour_cost\": ",
+                first ? "" : ",\n", r->solver, r->distribution, r->size, r->threads,
+                r->read, r->distances, r->construction, r->optimization, r->write, r->total, r->peakRssKb);
+        if (isnan(r->tourCost)) {
+            fprintf(out, "null");
+        } else {
+            fprintf(out, "%.6f", r->tourCost);
+        }
+        fprintf(out, ", \"status\": %d}", r->status);
+    } else {
+        fprintf(out, "%s,%s,%d,%d,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f,%ld,%.6f,%d\n",
+                r->solver, r->distribution, r->size, r->threads,
+                r->read, r->distances, r->construction, r->optimization, r->write, r->total, r->peakRssKb,
+                r->tourCost, r->status);
+    }
+}
@@ -0,0 +1,279 @@
+// cheapestInsertion.c
+// Cheapest insertion: repeatedly insert the vertex whose cheapest tour edge adds the
+// least length, caching each vertex's cheapest edge between steps.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include "tspSolver.h"
+
+// Function prototypes
+static int buildTour(const TspProblem* problem, int start, double deadline, void* workspace, TspTour** built);
+static int reserveWorkspace(CheapestWorkspace* workspace, int numOfCoords);
+static void offerEdge(const TspProblem* problem, int i, int a, int b, const TspTour* tour, int* bestFrom, double* bestIncrease);
+static void rescanNeighborEdges(const TspProblem* problem, int i, const TspTour* tour, const int* visited, int* bestFrom, double* bestIncrease);
+
+// Grow the workspace to numOfCoords vertices, 0 on success and -1 on failure
+static int reserveWorkspace(CheapestWorkspace* workspace, int numOfCoords) {
+    if (numOfCoords <= workspace->capacity) {
+        return 0;
+    }
+    releaseCheapestWorkspace(workspace);
+
+    // Linked tour, its order index orders tied edges by their place in the tour
+    workspace->tour = createTour(numOfCoords, 1);
+    if (!workspace->tour) {
+        return -1;
+    }
+    workspace->visited = malloc(numOfCoords * sizeof(int));
+    workspace->bestFrom = malloc(numOfCoords * sizeof(int));
+    workspace->bestIncrease = malloc(numOfCoords * sizeof(double));
+    workspace->restricted = malloc(numOfCoords * sizeof(int));
+    workspace->order = malloc(numOfCoords * sizeof(int));
+    if (!workspace->visited || !workspace->bestFrom || !workspace->bestIncrease || !workspace->restricted || !workspace->order) {
+        perror("Memory allocation for insertion cache failed");
+        releaseCheapestWorkspace(workspace);
+        return -1;
+    }
+    workspace->capacity = numOfCoords;
+    return 0;
+}
+
+void releaseCheapestWorkspace(void* workspace) {
+    CheapestWorkspace* buffers = workspace;
+    freeTour(buffers->tour);
+    free(buffers->visited);
+    free(buffers->bestFrom);
+    free(buffers->bestIncrease);
+    free(buffers->restricted);
+    free(buffers->order);
+    releaseLocalSearch(&buffers->search);
+    releaseStartTeam(&buffers->starts, releaseCheapestWorkspace);
+    releasePartitionTeam(&buffers->partitions, releaseCheapestWorkspace);
+    memset(buffers, 0, sizeof(CheapestWorkspace));
+}
+
+int cheapestInsertionTour(const TspProblem* problem, CheapestWorkspace* buffers) {
+    if (reserveWorkspace(buffers, problem->numOfCoords) != 0) {
+        return -1;
+    }
+
+    // With --starts the shortest of the tours is copied into the workspace's tour
+    TspTour* tour = buffers->tour;
+    int start = 0;
+    if (partitioned(problem)) {
+        // The stitched tour has no start of its own and is written from vertex 0
+        if (runPartitions(problem, &buffers->partitions, sizeof(CheapestWorkspace), buildTour, tour) != 0) {
+            return -1;
+        }
+        start = -1;
+    } else if (problem->options.numStarts > 1) {
+        start = runStarts(problem, &buffers->starts, sizeof(CheapestWorkspace), buildTour, tour);
+        if (start < 0) {
+            return -1;
+        }
+    } else if (buildTour(problem, 0, DBL_MAX, buffers, &tour) != 0) {
+        return -1;
+    }
+    endPhase("construction");
+
+    // Shorten the tour with 2-opt and Or-opt, the constructed tour is kept if that fails
+    if (problem->options.optimize) {
+        improveLinkedTourWith(problem, tour, &buffers->search);
+        endPhase("optimization");
+    }
+
+    // The tour is written backwards from the vertex it started with, which is last
+    // in output order, a tour from another start from vertex 0 like the others
+    int current = start == 0 ? tour->prev[tour->head] : 0;
+    for (int i = 0; i < tour->size; i++, current = tour->prev[current]) {
+        buffers->order[i] = current;
+    }
+    return 0;
+}
+
+// Build the tour from vertex start with the workspace's buffers. 0 when it is built,
+// 1 when the deadline passed first and -1 on failure.
+static int buildTour(const TspProblem* problem, int start, double deadline, void* workspace, TspTour** built) {
+    int numOfCoords = problem->numOfCoords;
+    CheapestWorkspace* buffers = workspace;
+    if (reserveWorkspace(buffers, numOfCoords) != 0) {
+        return -1;
+    }
+    TspTour* tour = buffers->tour;
+    *built = tour;
+
+    // Boolean array to keep track of visited vertices
+    int* visited = buffers->visited;
+    memset(visited, 0, numOfCoords * sizeof(int));
+
+    // Cheapest insertion edge of every unvisited vertex: the edge leaving tour
+    // vertex bestFrom[i], and the increase in tour length of inserting i there
+    int* bestFrom = buffers->bestFrom;
+    double* bestIncrease = buffers->bestIncrease;
+    // With neighbour lists a vertex is restricted to the tour edges touching its
+    // visited neighbours once it has one, and considers every edge until then
+    int* restricted = buffers->restricted;
+    memset(restricted, 0, numOfCoords * sizeof(int));
+
+    // Start with the start vertex in the tour
+    startTour(tour, start);
+    visited[start] = 1; // Mark the first vertex as visited
+
+    // With a single vertex the only edge is the loop start -> start
+    for (int i = 0; i < numOfCoords; i++) {
+        bestFrom[i] = start;
+        bestIncrease[i] = getDistance(problem, start, i) + getDistance(problem, i, start) - getDistance(problem, start, start);
+    }
+    addCount(COUNT_CANDIDATES, numOfCoords - 1);
+    if (problem->numNeighbors > 0) {
+        for (int r = problem->reverseStart[start]; r < problem->reverseStart[start + 1]; r++) {
+            restricted[problem->reverseNeighbors[r]] = 1;
+        }
+    }
+
+    // We will use DBL_MAX from float.h to represent infinity
+    while (tour->size < numOfCoords) {
+        if (wallTime() > deadline) {
+            return 1;
+        }
+        double minIncrease = DBL_MAX;
+        int minIndex = -1;
+
+        // Every cached edge is already the cheapest for its vertex, so picking the
+        // cheapest vertex needs one pass instead of a scan over all tour edges
+        // The first unvisited vertex is taken even when no increase is finite
+        for (int i = 0; i < numOfCoords; i++) {
+            if (!visited[i] && (minIndex < 0 || bestIncrease[i] < minIncrease)) {
+                minIncrease = bestIncrease[i];
+                minIndex = i;
+            }
+        }
+
+        // The chosen edge (from, to) is split into (from, minIndex) and (minIndex, to)
+        int from = bestFrom[minIndex];
+        int to = tour->next[from];
+
+        // Insert the vertex in the tour. Splitting the closing edge makes it the
+        // new first vertex, as shifting it into the front of an array did.
+        insertBefore(tour, to, minIndex);
+        visited[minIndex] = 1;
+        addCount(COUNT_STEPS, 1);
+
+        // Only the two new edges can improve on a cached edge that still exists,
+        // and they are scored against a block of candidates at a time.
+        // Vertices whose cached edge was the one just split are rescanned.
+        int newFrom[2] = { from, minIndex };
+        double increases[2][SCORE_BLOCK];
+        for (int first = 0; first < numOfCoords; first += SCORE_BLOCK) {
+            int count = numOfCoords - first < SCORE_BLOCK ? numOfCoords - first : SCORE_BLOCK;
+            insertionCosts(problem, from, minIndex, first, count, increases[0]);
+            insertionCosts(problem, minIndex, to, first, count, increases[1]);
+            addCount(COUNT_CANDIDATES, 2 * count);
+
+            for (int i = first; i < first + count; i++) {
+                if (visited[i]) {
+                    continue;
+                }
+
+                if (restricted[i]) {
+                    // Restricted vertices are updated from the neighbour lists below
+                    if (bestFrom[i] == from) {
+                        rescanNeighborEdges(problem, i, tour, visited, bestFrom, bestIncrease);
+                    }
+                    continue;
+                }
+
+                if (bestFrom[i] == from) {
+                    bestIncrease[i] = DBL_MAX;
+                    addCount(COUNT_CANDIDATES, tour->size);
+                    int current = tour->head;
+                    for (int j = 0; j < tour->size; j++, current = tour->next[current]) {
+                        int next = tour->next[current];
+                        double increase = getDistance(problem, current, i) + getDistance(problem, i, next) - getDistance(problem, current, next);
+
+                        if (increase < bestIncrease[i]) {
+                            bestIncrease[i] = increase;
+                            bestFrom[i] = current;
+                        }
+                    }
+                    continue;
+                }
+
+                // Ties go to the edge earlier in the tour, as in a full rescan
+                for (int k = 0; k < 2; k++) {
+                    double increase = increases[k][i - first];
+                    if (increase < bestIncrease[i] ||
+                        (increase == bestIncrease[i] && tourPrecedes(tour, newFrom[k], bestFrom[i]))) {
+                        bestIncrease[i] = increase;
+                        bestFrom[i] = newFrom[k];
+                    }
+                }
+            }
+        }
+
+        // The new edges are candidates for the vertices listing from, minIndex or to
+        // as a neighbour. Vertices seeing their first visited neighbour drop the
+        // edges found by the full scan and switch to their neighbours' edges.
+        if (problem->numNeighbors > 0) {
+            const int* reverseStart = problem->reverseStart;
+            const int* reverseNeighbors = problem->reverseNeighbors;
+            for (int r = reverseStart[minIndex]; r < reverseStart[minIndex + 1]; r++) {
+                int i = reverseNeighbors[r];
+                if (visited[i]) {
+                    continue;
+                }
+                if (!restricted[i]) {
+                    restricted[i] = 1;
+                    rescanNeighborEdges(problem, i, tour, visited, bestFrom, bestIncrease);
+                } else {
+                    offerEdge(problem, i, from, minIndex, tour, bestFrom, bestIncrease);
+                    offerEdge(problem, i, minIndex, to, tour, bestFrom, bestIncrease);
+                }
+            }
+            for (int r = reverseStart[from]; r < reverseStart[from + 1]; r++) {
+                int i = reverseNeighbors[r];
+                if (!visited[i] && restricted[i]) {
+                    offerEdge(problem, i, from, minIndex, tour, bestFrom, bestIncrease);
+                }
+            }
+            for (int r = reverseStart[to]; r < reverseStart[to + 1]; r++) {
+                int i = reverseNeighbors[r];
+                if (!visited[i] && restricted[i]) {
+                    offerEdge(problem, i, minIndex, to, tour, bestFrom, bestIncrease);
+                }
+            }
+        }
+    }
+
+    return 0;
+}
+
+// Make the edge (a, b) vertex i's cached edge if inserting i there is cheaper.
+// Ties go to the edge earlier in the tour, as in a full rescan.
+static void offerEdge(const TspProblem* problem, int i, int a, int b, const TspTour* tour, int* bestFrom, double* bestIncrease) {
+    double increase = getDistance(problem, a, i) + getDistance(problem, i, b) - getDistance(problem, a, b);
+    addCount(COUNT_CANDIDATES, 1);
+    if (increase < bestIncrease[i] ||
+        (increase == bestIncrease[i] && tourPrecedes(tour, a, bestFrom[i]))) {
+        bestIncrease[i] = increase;
+        bestFrom[i] = a;
+    }
+}
+
+// Recompute vertex i's cached edge from the two tour edges at each of its visited neighbours
+static void rescanNeighborEdges(const TspProblem* problem, int i, const TspTour* tour, const int* visited, int* bestFrom, double* bestIncrease) {
+    const int* neighbors = neighborsOf(problem, i);
+    bestIncrease[i] = DBL_MAX;
+    for (int m = 0; m < problem->numNeighbors; m++) {
+        int u = neighbors[m];
+        if (!visited[u]) {
+            continue;
+        }
+        int previous = tour->prev[u];
+        int next = tour->next[u];
+        offerEdge(problem, i, previous, u, tour, bestFrom, bestIncrease);
+        offerEdge(problem, i, u, next, tour, bestFrom, bestIncrease);
+    }
+}
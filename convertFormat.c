@@ -0,0 +1,115 @@
+// convertFormat.c
+// Convert coordinate and tour files between the text and binary formats: binary input
+// is written as text and text input as binary. Build with
+// gcc convertFormat.c tspProblem.c tspTour.c -o convertFormat -lm
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "tspProblem.h"
+#include "tspTour.h"
+
+typedef enum {
+    TEXT_COORDINATES,
+    TEXT_TOUR,
+    BINARY_COORDINATES,
+    BINARY_TOUR
+} FileKind;
+
+// Function prototypes
+static int detectKind(const char* filename, FileKind* kind);
+static int convertCoordinates(const char* inputFilename, const char* outputFilename, int toBinary, int useFloat);
+static int convertTour(const char* inputFilename, const char* outputFilename, int toBinary);
+
+int main(int argc, char* argv[]) {
+    int useFloat = 0;
+    if (argc == 4 && strcmp(argv[3], "--float") == 0) {
+        useFloat = 1;
+    } else if (argc != 3) {
+        printf("Usage: %s <input_file_name> <output_file_name> [--float]\n", argv[0]);
+        printf("Binary coordinate and tour files are written as text, text ones as binary.\n");
+        printf("  --float  store binary coordinates in single precision\n");
+        return 1;
+    }
+
+    const char* inputFilename = argv[1];
+    const char* outputFilename = argv[2];
+
+    FileKind kind;
+    if (detectKind(inputFilename, &kind) != 0) {
+        return EXIT_FAILURE;
+    }
+    int status;
+    switch (kind) {
+        case TEXT_COORDINATES:
+        case BINARY_COORDINATES:
+            status = convertCoordinates(inputFilename, outputFilename, kind == TEXT_COORDINATES, useFloat);
+            break;
+        default:
+            status = convertTour(inputFilename, outputFilename, kind == TEXT_TOUR);
+            break;
+    }
+    return status == 0 ? 0 : EXIT_FAILURE;
+}
+
+// Binary files are known by their magic; text coordinates have commas, tours never do
+static int detectKind(const char* filename, FileKind* kind) {
+    FILE* file = fopen(filename, "rb");
+    if (!file) {
+        perror("Error opening input file");
+        return -1;
+    }
+    char start[4096];
+    size_t length = fread(start, 1, sizeof(start), file);
+    fclose(file);
+
+    uint32_t magic = 0;
+    if (length >= sizeof(magic)) {
+        memcpy(&magic, start, sizeof(magic));
+    }
+    if (magic == BINARY_COORDS_MAGIC) {
+        *kind = BINARY_COORDINATES;
+    } else if (magic == BINARY_TOUR_MAGIC) {
+        *kind = BINARY_TOUR;
+    } else {
+        *kind = memchr(start, ',', length) ? TEXT_COORDINATES : TEXT_TOUR;
+    }
+    return 0;
+}
+
+static int convertCoordinates(const char* inputFilename, const char* outputFilename, int toBinary, int useFloat) {
+    TspProblem* problem = readCoordinates(inputFilename);
+    if (!problem) {
+        return -1;
+    }
+    int status = toBinary ? writeBinaryCoordinates(problem, outputFilename, useFloat)
+                          : writeTextCoordinates(problem, outputFilename);
+    if (status == 0) {
+        printf("Wrote %d coordinates to %s\n", problem->numOfCoords, outputFilename);
+    }
+    freeProblem(problem);
+    return status;
+}
+
+static int convertTour(const char* inputFilename, const char* outputFilename, int toBinary) {
+    int numOfCoords = countTourVertices(inputFilename);
+    if (numOfCoords <= 0) {
+        fprintf(stderr, "Error: %s contains no tour\n", inputFilename);
+        return -1;
+    }
+    int* order = malloc(numOfCoords * sizeof(int));
+    if (!order) {
+        perror("Memory allocation for tour failed");
+        return -1;
+    }
+
+    int status = readTourFile(inputFilename, numOfCoords, order);
+    if (status == 0) {
+        status = toBinary ? writeBinaryTourFile(outputFilename, order, numOfCoords)
+                          : writeTourFile(outputFilename, order, numOfCoords);
+    }
+    if (status == 0) {
+        printf("Wrote a tour of %d vertices to %s\n", numOfCoords, outputFilename);
+    }
+    free(order);
+    return status;
+}
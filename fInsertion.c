@@ -1,165 +1,59 @@
+// fInsertion.c
+// Command line of farthest insertion, see tspSolver.h. Build with
+// gcc fInsertion.c farthestInsertion.c batch.c tspProblem.c tspTour.c twoLevelList.c localSearch.c -o fInsertion -lm
 #include <stdio.h>
 #include <stdlib.h>
-#include <math.h>
-#include <float.h>
-
-#define MAX_COORDS 4096 // Maximum number of coordinates
-
-// Global variables
-double coords[MAX_COORDS][2]; //  coordinates read from file
-double distanceMatrix[MAX_COORDS][MAX_COORDS]; //  calculated distance matrix
-int numOfCoords; // umber of coordinates read from file
+#include <string.h>
+#include "tspSolver.h"
 
 // Function prototypes
-void readCoordinates(const char* filename);
-void calculateDistanceMatrix();
-void farthestInsertion(const char* outputFilename);
+static int farthestInsertion(const TspProblem* problem, const char* outputFilename, void* workspace);
 
 int main(int argc, char* argv[]) {
-    if (argc != 3) {
-        printf("Usage: %s <coordinate_file_name> <output_file_name>\n", argv[0]);
+    TspOptions options;
+    if (argc < 3 || parseOptions(argc - 3, argv + 3, &options) != 0) {
+        printf("Usage: %s <coordinate_file_name> <output_file_name> [options]\n", argv[0]);
+        printf("       %s --batch <manifest_file_name> [options]\n", argv[0]);
+        printf("A manifest lists one \"<coordinate_file_name> <output_file_name>\" pair per line, - reads it from stdin.\n");
+        printOptionsUsage();
         return 1;
     }
+    if (strcmp(argv[1], "--batch") == 0) {
+        int failures = runBatch(argv[2], &options, farthestInsertion, sizeof(FarthestWorkspace), releaseFarthestWorkspace);
+        return failures == 0 ? 0 : EXIT_FAILURE;
+    }
 
     const char* inputFilename = argv[1];
     const char* outputFilename = argv[2];
 
-    readCoordinates(inputFilename);
-    calculateDistanceMatrix();
-    farthestInsertion(outputFilename);
-
-    return 0;
-}
-
-// Function to read coordinates from file and populate the coords array
-void readCoordinates(const char* filename) {
-    FILE* file = fopen(filename, "r");
-    if (file == NULL) {
-        perror("Error opening file");
-        exit(EXIT_FAILURE);
+    TspProblem* problem = readCoordinates(inputFilename);
+    if (!problem) {
+        return EXIT_FAILURE;
     }
-
-    numOfCoords = 0;
-    while (fscanf(file, "%lf,%lf", &coords[numOfCoords][0], &coords[numOfCoords][1]) == 2) {
-        numOfCoords++;
+    endPhase("read");
+    if (prepareDistances(problem, &options) != 0) {
+        freeProblem(problem);
+        return EXIT_FAILURE;
     }
+    endPhase("distances");
+    FarthestWorkspace workspace = { 0 };
+    int status = farthestInsertion(problem, outputFilename, &workspace);
+    releaseFarthestWorkspace(&workspace);
+    freeProblem(problem);
 
-    fclose(file);
+    return status == 0 ? 0 : EXIT_FAILURE;
 }
 
-// Function to calculate the Euclidean distance between two points
-double euclideanDistance(double x1, double y1, double x2, double y2) {
-    return sqrt((x1 - x2) * (x1 - x2) + (y1 - y2) * (y1 - y2));
-}
-
-// Function to generate the distance matrix from the coordinates
-void calculateDistanceMatrix() {
-    for (int i = 0; i < numOfCoords; i++) {
-        for (int j = 0; j < numOfCoords; j++) {
-            if (i == j) {
-                distanceMatrix[i][j] = 0.0;
-            } else {
-                distanceMatrix[i][j] = euclideanDistance(coords[i][0], coords[i][1], coords[j][0], coords[j][1]);
-            }
-        }
-    }
-}
-
-
-void farthestInsertion(const char* outputFilename) {
-    // Array to hold the tour
-    int* tour = malloc(numOfCoords * sizeof(int));
-    if (!tour) {
-        perror("Memory allocation for tour failed");
-        exit(EXIT_FAILURE);
-    }
-
-    // Boolean array to keep track of visited vertices
-    int* visited = calloc(numOfCoords, sizeof(int));
-    if (!visited) {
-        free(tour);
-        perror("Memory allocation for visited failed");
-        exit(EXIT_FAILURE);
-    }
-
-    // Initialize the tour starting with vertex 0
-    tour[0] = 0;
-    visited[0] = 1;
-    int tourSize = 1;
-
-    // Find the farthest vertex from vertex 0 to start the tour
-    double maxDist = 0;
-    int farthest = -1;
-    for (int i = 1; i < numOfCoords; i++) {
-        double dist = distanceMatrix[0][i];
-        if (dist > maxDist) {
-            maxDist = dist;
-            farthest = i;
-        }
-    }
-    tour[1] = farthest;
-    visited[farthest] = 1;
-    tourSize++;
-
-    // Continue with the farthest insertion heuristic
-    while (tourSize < numOfCoords) {
-        maxDist = 0;
-        farthest = -1;
-
-        // Find the farthest unvisited vertex from the current tour
-        for (int i = 0; i < numOfCoords; i++) {
-            if (!visited[i]) {
-                for (int j = 0; j < tourSize; j++) {
-                    double dist = distanceMatrix[i][tour[j]];
-                    if (dist > maxDist) {
-                        maxDist = dist;
-                        farthest = i;
-                    }
-                }
-            }
-        }
-
-        // Find the best position to insert the farthest vertex
-        double minIncrease = DBL_MAX;
-        int positionToInsert = 0;
-        for (int i = 0; i < tourSize; i++) {
-            int next = (i + 1) % tourSize;
-            double increase = distanceMatrix[tour[i]][farthest] + distanceMatrix[farthest][tour[next]] - distanceMatrix[tour[i]][tour[next]];
-            if (increase < minIncrease) {
-                minIncrease = increase;
-                positionToInsert = i + 1;
-            }
-        }
-
-        // Insert the farthest vertex into the tour
-        for (int i = tourSize; i > positionToInsert; i--) {
-            tour[i] = tour[i - 1];
-        }
-        tour[positionToInsert] = farthest;
-        visited[farthest] = 1;
-        tourSize++;
-    }
-
-    // Open the output file to write the tour
-    FILE* file = fopen(outputFilename, "w");
-    if (file == NULL) {
-        perror("Error opening output file");
-        free(tour);
-        free(visited);
-        exit(EXIT_FAILURE);
-    }
-
-    // Write the count of elements in the tour on the first line, including the return to the start
-    fprintf(file, "%d\n", tourSize + 1);
-
-    // Write the tour to the output file, ensuring it starts and ends with 0
-    for (int i = 0; i < tourSize; i++) {
-        fprintf(file, "%d ", tour[i]);
-    }
-    // Ensure the tour ends with the starting point (0)
-    fprintf(file, "%d\n", tour[0]);
-
-    fclose(file);
-    free(tour);
-    free(visited);
+// Build the tour with the workspace's buffers and write it, 0 on success and -1 on failure
+static int farthestInsertion(const TspProblem* problem, const char* outputFilename, void* workspace) {
+    FarthestWorkspace* buffers = workspace;
+    if (farthestInsertionTour(problem, buffers) != 0) {
+        return -1;
+    }
+    int numOfCoords = problem->numOfCoords;
+    toOriginalIds(problem, buffers->order, numOfCoords);
+    int status = problem->options.binaryOutput ? writeBinaryTourFile(outputFilename, buffers->order, numOfCoords)
+                                               : writeTourFile(outputFilename, buffers->order, numOfCoords);
+    endPhase("write");
+    return status;
 }
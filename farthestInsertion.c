@@ -0,0 +1,307 @@
+// farthestInsertion.c
+// Farthest insertion: repeatedly insert the vertex farthest from the tour on the tour
+// edge where it adds the least length, keeping the unvisited vertices in a heap.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include "tspSolver.h"
+
+// Function prototypes
+static int buildTour(const TspProblem* problem, int start, double deadline, void* workspace, TspTour** built);
+static int reserveWorkspace(FarthestWorkspace* workspace, int numOfCoords);
+static void siftDown(FarthestWorkspace* buffers, int heapSize, int slot);
+static void removeFromCell(FarthestWorkspace* buffers, int v);
+static void updateMinDistances(const TspProblem* problem, FarthestWorkspace* buffers, int inserted, double radius, int heapSize);
+
+// Grow the workspace to numOfCoords vertices, 0 on success and -1 on failure
+static int reserveWorkspace(FarthestWorkspace* workspace, int numOfCoords) {
+    if (numOfCoords <= workspace->capacity) {
+        return 0;
+    }
+    releaseFarthestWorkspace(workspace);
+
+    // Linked tour, its order index orders tied edges by their place in the tour
+    workspace->tour = createTour(numOfCoords, 1);
+    if (!workspace->tour) {
+        return -1;
+    }
+    workspace->visited = malloc(numOfCoords * sizeof(int));
+    workspace->minDistance = malloc(numOfCoords * sizeof(double));
+    workspace->heap = malloc(numOfCoords * sizeof(int));
+    workspace->heapPos = malloc(numOfCoords * sizeof(int));
+    workspace->gridPos = malloc(numOfCoords * sizeof(int));
+    workspace->order = malloc(numOfCoords * sizeof(int));
+    if (!workspace->visited || !workspace->minDistance || !workspace->heap || !workspace->heapPos || !workspace->gridPos ||
+        !workspace->order) {
+        perror("Memory allocation for farthest insertion failed");
+        releaseFarthestWorkspace(workspace);
+        return -1;
+    }
+    workspace->capacity = numOfCoords;
+    return 0;
+}
+
+void releaseFarthestWorkspace(void* workspace) {
+    FarthestWorkspace* buffers = workspace;
+    freeTour(buffers->tour);
+    free(buffers->visited);
+    free(buffers->minDistance);
+    free(buffers->heap);
+    free(buffers->heapPos);
+    free(buffers->gridPos);
+    free(buffers->cellFirst);
+    freeSpatialGrid(&buffers->grid);
+    free(buffers->order);
+    releaseLocalSearch(&buffers->search);
+    releaseStartTeam(&buffers->starts, releaseFarthestWorkspace);
+    releasePartitionTeam(&buffers->partitions, releaseFarthestWorkspace);
+    memset(buffers, 0, sizeof(FarthestWorkspace));
+}
+
+// Whether unvisited vertex a is farther from the tour than b, ties go to the lowest id
+static inline int farther(const double* minDistance, int a, int b) {
+    return minDistance[a] > minDistance[b] || (minDistance[a] == minDistance[b] && a < b);
+}
+
+// Move the vertex in the given heap slot down until no child is farther than it
+static void siftDown(FarthestWorkspace* buffers, int heapSize, int slot) {
+    int* heap = buffers->heap;
+    const double* minDistance = buffers->minDistance;
+    int v = heap[slot];
+    while (2 * slot + 1 < heapSize) {
+        int child = 2 * slot + 1;
+        if (child + 1 < heapSize && farther(minDistance, heap[child + 1], heap[child])) {
+            child++;
+        }
+        if (!farther(minDistance, heap[child], v)) {
+            break;
+        }
+        heap[slot] = heap[child];
+        buffers->heapPos[heap[slot]] = slot;
+        slot = child;
+    }
+    heap[slot] = v;
+    buffers->heapPos[v] = slot;
+}
+
+// Move v to the front of its cell, out of the unvisited part
+static void removeFromCell(FarthestWorkspace* buffers, int v) {
+    SpatialGrid* grid = &buffers->grid;
+    int first = buffers->cellFirst[grid->cellOf[v]]++;
+    int u = grid->cellVertices[first];
+    grid->cellVertices[buffers->gridPos[v]] = u;
+    buffers->gridPos[u] = buffers->gridPos[v];
+    grid->cellVertices[first] = v;
+    buffers->gridPos[v] = first;
+}
+
+// Column or row of the grid holding position, clamped to the grid, 0 for NaN
+static inline int clampCell(double position, int count) {
+    if (!(position >= 0.0)) {
+        return 0;
+    }
+    return position >= count - 1 ? count - 1 : (int)position;
+}
+
+// Fold the distances from the vertex inserted last into minDistance. Every unvisited
+// vertex is within radius of the tour, so only those within radius of the inserted
+// vertex can come closer, and only the cells reaching that close in the plane are
+// scanned, every cell when the metric puts no bound on the plane.
+static void updateMinDistances(const TspProblem* problem, FarthestWorkspace* buffers, int inserted, double radius, int heapSize) {
+    const SpatialGrid* grid = &buffers->grid;
+    double* minDistance = buffers->minDistance;
+    double px = problem->x[inserted];
+    double py = problem->y[inserted];
+
+    // Distances may be rounded through single precision coordinates or tables, so
+    // the reach allows for that error relative to the radius and to the coordinates
+    int firstCol = 0, lastCol = grid->cols - 1, firstRow = 0, lastRow = grid->rows - 1;
+    double reach = radius < DBL_MAX ? planarReach(problem, radius) : DBL_MAX;
+    if (reach < DBL_MAX) {
+        double farX = fabs(grid->minX) + grid->cols * grid->cellSize;
+        double farY = fabs(grid->minY) + grid->rows * grid->cellSize;
+        reach = reach * (1.0 + 16 * FLT_EPSILON) + 16 * FLT_EPSILON * (farX > farY ? farX : farY);
+        firstCol = clampCell((px - reach - grid->minX) / grid->cellSize, grid->cols);
+        lastCol = clampCell((px + reach - grid->minX) / grid->cellSize, grid->cols);
+        firstRow = clampCell((py - reach - grid->minY) / grid->cellSize, grid->rows);
+        lastRow = clampCell((py + reach - grid->minY) / grid->cellSize, grid->rows);
+    }
+
+    for (int cy = firstRow; cy <= lastRow; cy++) {
+        for (int cx = firstCol; cx <= lastCol; cx++) {
+            int cell = cy * grid->cols + cx;
+            if (buffers->cellFirst[cell] == grid->cellStart[cell + 1] || cellDistance(grid, px, py, cx, cy) > reach) {
+                continue;
+            }
+            addCount(COUNT_DISTANCES, grid->cellStart[cell + 1] - buffers->cellFirst[cell]);
+            for (int k = buffers->cellFirst[cell]; k < grid->cellStart[cell + 1]; k++) {
+                int v = grid->cellVertices[k];
+                double distance = getDistance(problem, inserted, v);
+                if (distance < minDistance[v]) {
+                    minDistance[v] = distance;
+                    siftDown(buffers, heapSize, buffers->heapPos[v]);
+                }
+            }
+        }
+    }
+}
+
+int farthestInsertionTour(const TspProblem* problem, FarthestWorkspace* buffers) {
+    if (reserveWorkspace(buffers, problem->numOfCoords) != 0) {
+        return -1;
+    }
+
+    // With --starts the shortest of the tours is copied into the workspace's tour.
+    // A start vertex and the vertex farthest from it, inserted next, seed each tour.
+    TspTour* tour = buffers->tour;
+    int start = 0;
+    if (partitioned(problem)) {
+        // The stitched tour has no start of its own and is written from vertex 0
+        if (runPartitions(problem, &buffers->partitions, sizeof(FarthestWorkspace), buildTour, tour) != 0) {
+            return -1;
+        }
+        start = -1;
+    } else if (problem->options.numStarts > 1) {
+        start = runStarts(problem, &buffers->starts, sizeof(FarthestWorkspace), buildTour, tour);
+        if (start < 0) {
+            return -1;
+        }
+    } else if (buildTour(problem, 0, DBL_MAX, buffers, &tour) != 0) {
+        return -1;
+    }
+    endPhase("construction");
+
+    // Shorten the tour with 2-opt and Or-opt, the constructed tour is kept if that fails
+    if (problem->options.optimize) {
+        improveLinkedTourWith(problem, tour, &buffers->search);
+        endPhase("optimization");
+    }
+
+    // The tour is written from the vertex it started with, a tour from another start
+    // from vertex 0 like the others
+    int current = start == 0 ? tour->head : 0;
+    for (int i = 0; i < tour->size; i++, current = tour->next[current]) {
+        buffers->order[i] = current;
+    }
+    return 0;
+}
+
+// Build the tour from vertex start with the workspace's buffers. 0 when it is built,
+// 1 when the deadline passed first and -1 on failure.
+static int buildTour(const TspProblem* problem, int start, double deadline, void* workspace, TspTour** built) {
+    int numOfCoords = problem->numOfCoords;
+    FarthestWorkspace* buffers = workspace;
+    if (reserveWorkspace(buffers, numOfCoords) != 0) {
+        return -1;
+    }
+    TspTour* tour = buffers->tour;
+    *built = tour;
+
+    // Boolean array to keep track of visited vertices
+    int* visited = buffers->visited;
+    memset(visited, 0, numOfCoords * sizeof(int));
+
+    // Every vertex starts infinitely far from the tour, so the heap in id order is valid
+    double* minDistance = buffers->minDistance;
+    int* heap = buffers->heap;
+    int heapSize = 0;
+    for (int i = 0; i < numOfCoords; i++) {
+        minDistance[i] = DBL_MAX;
+        if (i != start) {
+            heap[heapSize] = i;
+            buffers->heapPos[i] = heapSize++;
+        }
+    }
+    if (buildSpatialGrid(problem, &buffers->grid) != 0) {
+        return -1;
+    }
+    int cells = buffers->grid.cols * buffers->grid.rows;
+    if (cells > buffers->cellCapacity) {
+        free(buffers->cellFirst);
+        buffers->cellFirst = malloc(cells * sizeof(int));
+        buffers->cellCapacity = buffers->cellFirst ? cells : 0;
+        if (!buffers->cellFirst) {
+            perror("Memory allocation for farthest insertion failed");
+            return -1;
+        }
+    }
+    memcpy(buffers->cellFirst, buffers->grid.cellStart, cells * sizeof(int));
+    for (int k = 0; k < numOfCoords; k++) {
+        buffers->gridPos[buffers->grid.cellVertices[k]] = k;
+    }
+
+    // Initialize the tour with the start vertex
+    startTour(tour, start);
+    visited[start] = 1;
+    removeFromCell(buffers, start);
+    int inserted = start; // Vertex added to the tour last
+    double radius = DBL_MAX; // No unvisited vertex is farther from the tour
+
+    // Continue with the farthest insertion heuristic
+    while (tour->size < numOfCoords) {
+        if (wallTime() > deadline) {
+            return 1;
+        }
+        // Only the vertex inserted last can bring the tour closer to a vertex, so
+        // its distances are folded in before the farthest vertex leaves the heap
+        updateMinDistances(problem, buffers, inserted, radius, heapSize);
+        int farthest = heap[0];
+        if (--heapSize > 0) {
+            heap[0] = heap[heapSize];
+            siftDown(buffers, heapSize, 0);
+        }
+        removeFromCell(buffers, farthest);
+        radius = minDistance[farthest];
+
+        // Find the best edge (insertAfterVertex, next) to insert the farthest vertex
+        // on. With neighbour lists only the edges on either side of its visited
+        // neighbours are tried, and every edge when none is visited yet. Ties go
+        // to the edge earliest in the tour. The first edge tried is taken even when no
+        // increase is finite, as with coordinates so large that distances overflow.
+        double minIncrease = DBL_MAX;
+        int insertAfterVertex = -1;
+        int neighborEdges = 0;
+        const int* neighbors = problem->numNeighbors > 0 ? neighborsOf(problem, farthest) : NULL;
+        for (int m = 0; m < problem->numNeighbors; m++) {
+            int u = neighbors[m];
+            if (!visited[u]) {
+                continue;
+            }
+            int edges[2] = { tour->prev[u], u };
+            addCount(COUNT_CANDIDATES, 2);
+            for (int e = 0; e < 2; e++) {
+                int from = edges[e];
+                int next = tour->next[from];
+                double increase = getDistance(problem, from, farthest) + getDistance(problem, farthest, next) - getDistance(problem, from, next);
+                if (insertAfterVertex < 0 || increase < minIncrease ||
+                    (increase == minIncrease && tourPrecedes(tour, from, insertAfterVertex))) {
+                    minIncrease = increase;
+                    insertAfterVertex = from;
+                }
+            }
+            neighborEdges = 1;
+        }
+        if (!neighborEdges) {
+            addCount(COUNT_CANDIDATES, tour->size);
+        }
+        int current = tour->head;
+        for (int i = 0; i < tour->size && !neighborEdges; i++, current = tour->next[current]) {
+            int next = tour->next[current];
+            double increase = getDistance(problem, current, farthest) + getDistance(problem, farthest, next) - getDistance(problem, current, next);
+            if (insertAfterVertex < 0 || increase < minIncrease) {
+                minIncrease = increase;
+                insertAfterVertex = current;
+            }
+        }
+
+        // Insert the farthest vertex into the tour
+        insertAfter(tour, insertAfterVertex, farthest);
+        visited[farthest] = 1;
+        inserted = farthest;
+        addCount(COUNT_STEPS, 1);
+    }
+
+    return 0;
+}
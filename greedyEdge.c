@@ -0,0 +1,346 @@
+// greedyEdge.c
+// Greedy edge construction: candidate edges to each vertex's nearest neighbours are
+// taken shortest first whenever both ends have a free degree and the edge closes no
+// cycle, and the paths left over are joined the same way between their ends. Runs
+// in about O(n k log n) for k neighbours. Build with -fopenmp to sort the edges on
+// every core, e.g.
+// gcc -fopenmp greedyEdge.c tspProblem.c tspTour.c twoLevelList.c localSearch.c -o greedyEdge -lm
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "tspProblem.h"
+#include "tspTour.h"
+#include "localSearch.h"
+
+#define GREEDY_NEIGHBORS 10 // candidates per vertex when no --neighbors is given
+#define RADIX_BITS 8 // key bits sorted per radix pass
+#define RADIX_BUCKETS (1 << RADIX_BITS)
+
+// Each thread sorts a contiguous slice, so the sort is stable whatever the team size
+#ifdef _OPENMP
+#include <omp.h>
+#define PARALLEL_SORT _Pragma("omp parallel")
+#define SORT_BARRIER _Pragma("omp barrier")
+#define SORT_SINGLE _Pragma("omp single")
+#define THREAD_NUM omp_get_thread_num()
+#define NUM_THREADS omp_get_num_threads()
+#define MAX_THREADS omp_get_max_threads()
+#else
+#define PARALLEL_SORT
+#define SORT_BARRIER
+#define SORT_SINGLE
+#define THREAD_NUM 0
+#define NUM_THREADS 1
+#define MAX_THREADS 1
+#endif
+
+// Degrees, path fragments and adjacency of the edges taken so far
+typedef struct {
+    int* degree;
+    int* adjacent; // the two tour neighbours of each vertex, -1 while free
+    int* parent; // union-find forest of the fragments
+    int* size; // vertices under each union-find root
+    int edges; // edges taken
+} GreedyState;
+
+// Function prototypes
+static int greedyTour(const TspProblem* problem, int k, int* order);
+static int takeEdges(const TspProblem* problem, const int* vertices, int count, const int* neighbors, int k, GreedyState* state);
+static int sortByKey(uint64_t* items, size_t count);
+static int findRoot(int* parent, int v);
+
+int main(int argc, char* argv[]) {
+    TspOptions options;
+    if (argc < 3 || parseOptions(argc - 3, argv + 3, &options) != 0) {
+        printf("Usage: %s <coordinate_file_name> <output_file_name> [options]\n", argv[0]);
+        printf("--neighbors=K sets the candidate edges per vertex (default %d).\n", GREEDY_NEIGHBORS);
+        printOptionsUsage();
+        return 1;
+    }
+
+    const char* inputFilename = argv[1];
+    const char* outputFilename = argv[2];
+
+    // Only the local search needs a distance table
+    if (!options.optimize) {
+        options.distanceMode = DISTANCES_NONE;
+    }
+    TspProblem* problem = readCoordinates(inputFilename);
+    if (!problem) {
+        return EXIT_FAILURE;
+    }
+    endPhase("read");
+    if (prepareDistances(problem, &options) != 0) {
+        freeProblem(problem);
+        return EXIT_FAILURE;
+    }
+    endPhase("distances");
+
+    int numOfCoords = problem->numOfCoords;
+    int* order = malloc(numOfCoords * sizeof(int));
+    if (!order) {
+        perror("Memory allocation for tour failed");
+        freeProblem(problem);
+        return EXIT_FAILURE;
+    }
+    int k = options.numNeighbors > 0 ? options.numNeighbors : GREEDY_NEIGHBORS;
+    if (greedyTour(problem, k, order) != 0) {
+        free(order);
+        freeProblem(problem);
+        return EXIT_FAILURE;
+    }
+    endPhase("construction");
+
+    // The greedy tour is kept if the improvement fails
+    if (options.optimize) {
+        improveTour(problem, order);
+        endPhase("optimization");
+    }
+
+    toOriginalIds(problem, order, numOfCoords);
+    int status = options.binaryOutput ? writeBinaryTourFile(outputFilename, order, numOfCoords)
+                                      : writeTourFile(outputFilename, order, numOfCoords);
+    endPhase("write");
+
+    free(order);
+    freeProblem(problem);
+    return status == 0 ? 0 : EXIT_FAILURE;
+}
+
+// Build the greedy tour from vertex 0 into order, 0 on success and -1 on failure
+static int greedyTour(const TspProblem* problem, int k, int* order) {
+    int n = problem->numOfCoords;
+    if (n == 1) {
+        order[0] = 0;
+        return 0;
+    }
+    k = k < n - 1 ? k : n - 1;
+
+    GreedyState state = { 0 };
+    state.degree = calloc(n, sizeof(int));
+    state.adjacent = malloc(2 * (size_t)n * sizeof(int));
+    state.parent = malloc(n * sizeof(int));
+    state.size = malloc(n * sizeof(int));
+    int* ends = malloc(n * sizeof(int));
+    int status = state.degree && state.adjacent && state.parent && state.size && ends ? 0 : -1;
+    if (status != 0) {
+        perror("Memory allocation for greedy edges failed");
+    }
+    for (int v = 0; status == 0 && v < n; v++) {
+        state.adjacent[2 * v] = state.adjacent[2 * v + 1] = -1;
+        state.parent[v] = v;
+        state.size[v] = 1;
+    }
+
+    // The problem's neighbour lists when it has them, nearest neighbours otherwise
+    if (status == 0 && problem->numNeighbors >= k) {
+        status = takeEdges(problem, NULL, n, problem->neighbors, problem->numNeighbors, &state);
+    } else if (status == 0) {
+        int* neighbors = findNearestNeighbors(problem, k);
+        status = neighbors ? takeEdges(problem, NULL, n, neighbors, k, &state) : -1;
+        free(neighbors);
+    }
+
+    // Join the paths between their ends, the vertices of degree below 2, until one is
+    // left. Ends whose nearest ends all lie on their own path look further next time.
+    int endK = k;
+    while (status == 0 && state.edges < n - 1) {
+        TspProblem* endProblem = calloc(1, sizeof(TspProblem));
+        int count = 0;
+        for (int v = 0; v < n; v++) {
+            if (state.degree[v] < 2) {
+                ends[count++] = v;
+            }
+        }
+        if (endProblem) {
+            endProblem->x = malloc(count * sizeof(double));
+            endProblem->y = malloc(count * sizeof(double));
+        }
+        if (!endProblem || !endProblem->x || !endProblem->y) {
+            perror("Memory allocation for path ends failed");
+            freeProblem(endProblem);
+            status = -1;
+            break;
+        }
+        endProblem->numOfCoords = count;
+        for (int e = 0; e < count; e++) {
+            endProblem->x[e] = problem->x[ends[e]];
+            endProblem->y[e] = problem->y[ends[e]];
+        }
+        int kEnds = endK < count - 1 ? endK : count - 1;
+        int* neighbors = findNearestNeighbors(endProblem, kEnds);
+        int before = state.edges;
+        status = neighbors ? takeEdges(problem, ends, count, neighbors, kEnds, &state) : -1;
+        free(neighbors);
+        freeProblem(endProblem);
+        if (state.edges == before) {
+            endK *= 2;
+        }
+    }
+
+    // Walk from vertex 0 to one end of the path filling the tour forwards, then to the
+    // other end filling it backwards, so the two ends meet where the tour closes
+    if (status == 0) {
+        order[0] = 0;
+        int position[2] = { 1, n - 1 };
+        int step[2] = { 1, -1 };
+        for (int side = 0; side < 2; side++) {
+            int previous = 0;
+            int v = state.adjacent[side];
+            while (v >= 0) {
+                order[position[side]] = v;
+                position[side] += step[side];
+                int next = state.adjacent[2 * v] != previous ? state.adjacent[2 * v] : state.adjacent[2 * v + 1];
+                previous = v;
+                v = next;
+            }
+        }
+    }
+
+    free(state.degree);
+    free(state.adjacent);
+    free(state.parent);
+    free(state.size);
+    free(ends);
+    return status;
+}
+
+// Take the candidate edges from each of count vertices to its k neighbours, shortest
+// first, that join two paths at free ends. Vertex i is vertices[i], or i itself when
+// vertices is NULL, and so are its neighbours. An edge listed from both of its ends
+// is scored once. 0 on success and -1 on failure.
+static int takeEdges(const TspProblem* problem, const int* vertices, int count, const int* neighbors, int k, GreedyState* state) {
+    // Each item is the quantised length above the candidate's index, so sorting the
+    // items by their upper half orders the candidates by length, ties by index
+    size_t numCandidates = (size_t)count * k;
+    uint64_t* items = malloc(numCandidates * sizeof(uint64_t));
+    if (!items) {
+        perror("Memory allocation for candidate edges failed");
+        return -1;
+    }
+    size_t numItems = 0;
+    for (int i = 0; i < count; i++) {
+        const int* list = neighbors + (size_t)i * k;
+        for (int m = 0; m < k; m++) {
+            int j = list[m];
+            // Listed from both ends, the edge is scored from the lower one
+            int mutual = 0;
+            for (int r = 0; j < i && r < k; r++) {
+                mutual |= neighbors[(size_t)j * k + r] == i;
+            }
+            if (mutual) {
+                continue;
+            }
+            int a = vertices ? vertices[i] : i;
+            int b = vertices ? vertices[j] : j;
+            // Lengths are at least 0, where float bit patterns order like the values
+            float length = (float)coordinateDistance(problem, a, b);
+            uint32_t key;
+            memcpy(&key, &length, sizeof(key));
+            items[numItems++] = (uint64_t)key << 32 | (uint64_t)((size_t)i * k + m);
+        }
+    }
+    addCount(COUNT_CANDIDATES, numItems);
+    if (sortByKey(items, numItems) != 0) {
+        free(items);
+        return -1;
+    }
+
+    for (size_t c = 0; c < numItems; c++) {
+        uint32_t index = (uint32_t)items[c];
+        int i = (int)(index / k);
+        int j = neighbors[index];
+        int a = vertices ? vertices[i] : i;
+        int b = vertices ? vertices[j] : j;
+        if (state->degree[a] == 2 || state->degree[b] == 2) {
+            continue;
+        }
+        int rootA = findRoot(state->parent, a);
+        int rootB = findRoot(state->parent, b);
+        if (rootA == rootB) {
+            continue;
+        }
+        // The smaller fragment hangs under the larger
+        if (state->size[rootA] < state->size[rootB]) {
+            int swap = rootA;
+            rootA = rootB;
+            rootB = swap;
+        }
+        state->parent[rootB] = rootA;
+        state->size[rootA] += state->size[rootB];
+        state->adjacent[2 * a + state->degree[a]++] = b;
+        state->adjacent[2 * b + state->degree[b]++] = a;
+        state->edges++;
+        addCount(COUNT_STEPS, 1);
+    }
+    free(items);
+    return 0;
+}
+
+// Root of v's fragment, halving the path on the way
+static int findRoot(int* parent, int v) {
+    while (parent[v] != v) {
+        parent[v] = parent[parent[v]];
+        v = parent[v];
+    }
+    return v;
+}
+
+// Stable least significant digit radix sort of the items on their upper 32 bits. The
+// team splits the items into one slice per thread; each pass counts the slices'
+// digits, places every slice after the ones before it and scatters them in parallel.
+// 0 on success and -1 on failure.
+static int sortByKey(uint64_t* items, size_t count) {
+    uint64_t* scratch = malloc(count * sizeof(uint64_t));
+    size_t* offsets = malloc((size_t)MAX_THREADS * RADIX_BUCKETS * sizeof(size_t));
+    if (!scratch || !offsets) {
+        perror("Memory allocation for edge sort failed");
+        free(scratch);
+        free(offsets);
+        return -1;
+    }
+
+    uint64_t* from = items;
+    uint64_t* to = scratch;
+    for (int shift = 32; shift < 64; shift += RADIX_BITS) {
+        PARALLEL_SORT
+        {
+            int thread = THREAD_NUM;
+            int numThreads = NUM_THREADS;
+            size_t first = count * thread / numThreads;
+            size_t last = count * (thread + 1) / numThreads;
+            size_t* own = offsets + (size_t)thread * RADIX_BUCKETS;
+            memset(own, 0, RADIX_BUCKETS * sizeof(size_t));
+            for (size_t c = first; c < last; c++) {
+                own[(from[c] >> shift) & (RADIX_BUCKETS - 1)]++;
+            }
+            SORT_BARRIER
+
+            // Bucket by bucket, then slice by slice within a bucket
+            SORT_SINGLE
+            {
+                size_t position = 0;
+                for (int bucket = 0; bucket < RADIX_BUCKETS; bucket++) {
+                    for (int t = 0; t < numThreads; t++) {
+                        size_t slots = offsets[(size_t)t * RADIX_BUCKETS + bucket];
+                        offsets[(size_t)t * RADIX_BUCKETS + bucket] = position;
+                        position += slots;
+                    }
+                }
+            }
+
+            for (size_t c = first; c < last; c++) {
+                to[own[(from[c] >> shift) & (RADIX_BUCKETS - 1)]++] = from[c];
+            }
+        }
+        uint64_t* swap = from;
+        from = to;
+        to = swap;
+    }
+
+    // An even number of passes leaves the sorted items where they started
+    free(scratch);
+    free(offsets);
+    return 0;
+}
@@ -0,0 +1,68 @@
+// hilbertTour.c
+// Visit the vertices in the order of a Hilbert curve over their bounding box, a tour
+// built in O(n log n) for when latency matters more than length. With --optimize the
+// curve order seeds the 2-opt and Or-opt local search. Build with
+// gcc hilbertTour.c tspProblem.c tspTour.c twoLevelList.c localSearch.c -o hilbertTour -lm
+#include <stdio.h>
+#include <stdlib.h>
+#include "tspProblem.h"
+#include "tspTour.h"
+#include "localSearch.h"
+
+int main(int argc, char* argv[]) {
+    TspOptions options;
+    if (argc < 3 || parseOptions(argc - 3, argv + 3, &options) != 0) {
+        printf("Usage: %s <coordinate_file_name> <output_file_name> [options]\n", argv[0]);
+        printOptionsUsage();
+        return 1;
+    }
+
+    const char* inputFilename = argv[1];
+    const char* outputFilename = argv[2];
+
+    // The vertices are renumbered along the curve, so the tour is 0 .. n - 1. Only the
+    // local search needs distances, without it no table is built.
+    options.hilbertOrder = 1;
+    if (!options.optimize) {
+        options.distanceMode = DISTANCES_NONE;
+        options.numNeighbors = 0;
+    }
+
+    TspProblem* problem = readCoordinates(inputFilename);
+    if (!problem) {
+        return EXIT_FAILURE;
+    }
+    endPhase("read");
+    if (prepareDistances(problem, &options) != 0) {
+        freeProblem(problem);
+        return EXIT_FAILURE;
+    }
+    endPhase("distances");
+
+    int numOfCoords = problem->numOfCoords;
+    int* order = malloc(numOfCoords * sizeof(int));
+    if (!order) {
+        perror("Memory allocation for tour failed");
+        freeProblem(problem);
+        return EXIT_FAILURE;
+    }
+    for (int i = 0; i < numOfCoords; i++) {
+        order[i] = i;
+    }
+    endPhase("construction");
+
+    // The curve order is kept if the improvement fails
+    if (options.optimize) {
+        improveTour(problem, order);
+        endPhase("optimization");
+    }
+
+    toOriginalIds(problem, order, numOfCoords);
+    int status = options.binaryOutput ? writeBinaryTourFile(outputFilename, order, numOfCoords)
+                                      : writeTourFile(outputFilename, order, numOfCoords);
+    endPhase("write");
+
+    free(order);
+    freeProblem(problem);
+    return status == 0 ? 0 : EXIT_FAILURE;
+}
@@ -0,0 +1,292 @@
+// localSearch.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "localSearch.h"
+
+#define IMPROVEMENT_EPSILON 1e-10 // relative gain a move needs, so rounding never cycles
+#define CLOCK_INTERVAL 256 // vertices processed between checks of the time limit
+#define MAX_SEGMENT 3 // longest segment Or-opt moves
+
+typedef struct {
+    const TspProblem* problem;
+    int n;
+    TwoLevelList* tour;
+    const int* neighbors; // k nearest vertices of each vertex, closest first
+    int k;
+    int* queue; // vertices whose don't-look bit is off, in a ring of n slots
+    char* queued;
+    int queueHead;
+    int queueSize;
+} LocalSearch;
+
+static inline int succ(const LocalSearch* search, int v) {
+    return twoLevelNext(search->tour, v);
+}
+
+static inline int pred(const LocalSearch* search, int v) {
+    return twoLevelPrev(search->tour, v);
+}
+
+static inline double dist(const LocalSearch* search, int i, int j) {
+    return getDistance(search->problem, i, j);
+}
+
+static void push(LocalSearch* search, int v) {
+    if (search->queued[v]) {
+        return;
+    }
+    int slot = search->queueHead + search->queueSize;
+    search->queue[slot >= search->n ? slot - search->n : slot] = v;
+    search->queued[v] = 1;
+    search->queueSize++;
+}
+
+static int pop(LocalSearch* search) {
+    int v = search->queue[search->queueHead];
+    search->queueHead = search->queueHead + 1 == search->n ? 0 : search->queueHead + 1;
+    search->queueSize--;
+    search->queued[v] = 0;
+    return v;
+}
+
+// Replace the tour edges (a, b) and (c, d) with (a, c) and (b, d). Either b follows
+// a and d follows c, or b precedes a and d precedes c, in the current direction.
+static void twoOptMove(LocalSearch* search, int a, int b, int c, int d) {
+    if (succ(search, a) == b) {
+        twoLevelReverse(search->tour, b, c);
+    } else {
+        twoLevelReverse(search->tour, a, d);
+    }
+}
+
+// Try the 2-opt moves that add an edge from a to one of its nearest neighbours
+static int improveTwoOpt(LocalSearch* search, int a) {
+    const int* candidates = search->neighbors + (size_t)a * search->k;
+    for (int forward = 1; forward >= 0; forward--) {
+        int b = forward ? succ(search, a) : pred(search, a);
+        double removedAB = dist(search, a, b);
+        for (int m = 0; m < search->k; m++) {
+            int c = candidates[m];
+            double addedAC = dist(search, a, c);
+            // Neighbours are sorted, so no later c can gain either
+            if (addedAC >= removedAB) {
+                break;
+            }
+            int d = forward ? succ(search, c) : pred(search, c);
+            if (c == b || d == a) {
+                continue;
+            }
+            double removed = removedAB + dist(search, c, d);
+            double gain = removed - addedAC - dist(search, b, d);
+            if (gain > IMPROVEMENT_EPSILON * removed) {
+                twoOptMove(search, a, b, c, d);
+                push(search, a);
+                push(search, b);
+                push(search, c);
+                push(search, d);
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+// Try moving a segment of up to MAX_SEGMENT vertices that starts or ends at a,
+// possibly reversed, onto an edge at one of a's nearest neighbours
+static int improveOrOpt(LocalSearch* search, int a) {
+    const int* candidates = search->neighbors + (size_t)a * search->k;
+    for (int length = 1; length <= MAX_SEGMENT; length++) {
+        for (int atStart = 1; atStart >= 0; atStart--) {
+            if (length == 1 && !atStart) {
+                continue;
+            }
+            // The segment s1 .. s2 runs forward between p and nx
+            int s1 = a;
+            int s2 = a;
+            for (int s = 1; s < length; s++) {
+                if (atStart) {
+                    s2 = succ(search, s2);
+                } else {
+                    s1 = pred(search, s1);
+                }
+            }
+            int p = pred(search, s1);
+            int nx = succ(search, s2);
+            double removedSegment = dist(search, p, s1) + dist(search, s2, nx);
+            double closeGap = removedSegment - dist(search, p, nx);
+            // Written to reject a NaN gain too, which overflowing distances give
+            if (!(closeGap > 0.0)) {
+                continue;
+            }
+
+            for (int m = 0; m < search->k; m++) {
+                int v = candidates[m];
+                // a gains an edge to v, which must beat what closing the gap saves
+                if (dist(search, a, v) >= closeGap) {
+                    break;
+                }
+                if (twoLevelBetween(search->tour, s1, v, s2)) {
+                    continue;
+                }
+                for (int side = 0; side < 2; side++) {
+                    // The edge (c, e) with e following c, on either side of v
+                    int c = side == 0 ? v : pred(search, v);
+                    int e = side == 0 ? succ(search, v) : v;
+                    if (e == p || twoLevelBetween(search->tour, s1, c, s2) || twoLevelBetween(search->tour, s1, e, s2)) {
+                        continue;
+                    }
+                    double removedCE = dist(search, c, e);
+                    double keep = dist(search, c, s1) + dist(search, s2, e);
+                    double flip = dist(search, c, s2) + dist(search, s1, e);
+                    double removed = removedSegment + removedCE;
+                    double gain = closeGap + removedCE - (keep < flip ? keep : flip);
+                    if (!(gain > IMPROVEMENT_EPSILON * removed)) {
+                        continue;
+                    }
+
+                    // p s1..s2 nx..c e becomes p nx..c s2..s1 e by two reversals,
+                    // and a third turns the segment back when that is cheaper
+                    twoOptMove(search, p, s1, c, e);
+                    if (c != nx) {
+                        twoOptMove(search, p, c, nx, s2);
+                    }
+                    if (keep < flip) {
+                        twoOptMove(search, c, s2, s1, e);
+                    }
+                    push(search, p);
+                    push(search, nx);
+                    push(search, s1);
+                    push(search, s2);
+                    push(search, c);
+                    push(search, e);
+                    return 1;
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+// Grow the buffers to tours of numOfCoords vertices, 0 on success and -1 on failure
+static int reserveLocalSearch(LocalSearchBuffers* buffers, int numOfCoords) {
+    if (!buffers->tour) {
+        buffers->tour = createTwoLevelList(numOfCoords);
+    } else if (resizeTwoLevelList(buffers->tour, numOfCoords) != 0) {
+        freeTwoLevelList(buffers->tour);
+        buffers->tour = NULL;
+    }
+    if (!buffers->tour) {
+        return -1;
+    }
+    if (numOfCoords <= buffers->capacity) {
+        return 0;
+    }
+    free(buffers->queue);
+    free(buffers->queued);
+    free(buffers->neighbors);
+    free(buffers->order);
+    buffers->queue = malloc(numOfCoords * sizeof(int));
+    buffers->queued = malloc(numOfCoords * sizeof(char));
+    buffers->neighbors = malloc((size_t)numOfCoords * LOCAL_SEARCH_NEIGHBORS * sizeof(int));
+    buffers->order = malloc(numOfCoords * sizeof(int));
+    buffers->capacity = numOfCoords;
+    if (!buffers->queue || !buffers->queued || !buffers->neighbors || !buffers->order) {
+        perror("Memory allocation for local search failed");
+        buffers->capacity = 0;
+        return -1;
+    }
+    return 0;
+}
+
+void releaseLocalSearch(LocalSearchBuffers* buffers) {
+    freeTwoLevelList(buffers->tour);
+    free(buffers->queue);
+    free(buffers->queued);
+    free(buffers->neighbors);
+    freeSpatialGrid(&buffers->grid);
+    free(buffers->order);
+    memset(buffers, 0, sizeof(LocalSearchBuffers));
+}
+
+long improveTour(const TspProblem* problem, int* order) {
+    LocalSearchBuffers buffers = { 0 };
+    long moves = improveTourWith(problem, order, &buffers);
+    releaseLocalSearch(&buffers);
+    return moves;
+}
+
+long improveTourWith(const TspProblem* problem, int* order, LocalSearchBuffers* buffers) {
+    int n = problem->numOfCoords;
+    if (n < 5) {
+        return 0;
+    }
+    double start = wallTime();
+    if (reserveLocalSearch(buffers, n) != 0) {
+        return -1;
+    }
+
+    LocalSearch search = { .problem = problem, .n = n };
+    if (problem->numNeighbors > 0) {
+        search.neighbors = problem->neighbors;
+        search.k = problem->numNeighbors;
+    } else {
+        search.k = n - 1 < LOCAL_SEARCH_NEIGHBORS ? n - 1 : LOCAL_SEARCH_NEIGHBORS;
+        if (fillNearestNeighbors(problem, search.k, buffers->neighbors, &buffers->grid) != 0) {
+            return -1;
+        }
+        search.neighbors = buffers->neighbors;
+    }
+    search.tour = buffers->tour;
+    search.queue = buffers->queue;
+    search.queued = buffers->queued;
+    memset(search.queued, 0, n * sizeof(char));
+
+    // Every vertex starts with its don't-look bit off, in tour order
+    setTwoLevelOrder(search.tour, order, n);
+    for (int i = 0; i < n; i++) {
+        push(&search, order[i]);
+    }
+
+    long moves = 0;
+    long processed = 0;
+    long maxMoves = problem->options.maxMoves;
+    double timeLimit = problem->options.timeLimit;
+    while (search.queueSize > 0 && (maxMoves == 0 || moves < maxMoves)) {
+        if (timeLimit > 0.0 && ++processed % CLOCK_INTERVAL == 0 && wallTime() - start >= timeLimit) {
+            break;
+        }
+        int a = pop(&search);
+        if (improveTwoOpt(&search, a) || (n >= 8 && improveOrOpt(&search, a))) {
+            moves++;
+        }
+    }
+
+    // Hand the tour back from the same first vertex
+    twoLevelToArray(search.tour, order[0], order);
+    addCount(COUNT_MOVES, moves);
+    return moves;
+}
+
+long improveLinkedTour(const TspProblem* problem, TspTour* tour) {
+    LocalSearchBuffers buffers = { 0 };
+    long moves = improveLinkedTourWith(problem, tour, &buffers);
+    releaseLocalSearch(&buffers);
+    return moves;
+}
+
+long improveLinkedTourWith(const TspProblem* problem, TspTour* tour, LocalSearchBuffers* buffers) {
+    if (reserveLocalSearch(buffers, tour->size) != 0) {
+        return -1;
+    }
+
+    // The improved order still starts at the head. The array is not the search's
+    // own, whose buffers it reuses.
+    int* order = buffers->order;
+    tourToArray(tour, order);
+    long moves = improveTourWith(problem, order, buffers);
+    if (moves > 0) {
+        setTourOrder(tour, order, tour->size);
+    }
+    return moves;
+}
@@ -0,0 +1,40 @@
+// localSearch.h
+// 2-opt and Or-opt improvement of a finished tour, run by the solvers with --optimize
+// and by optimizeTour on an existing tour file.
+#ifndef LOCAL_SEARCH_H
+#define LOCAL_SEARCH_H
+
+#include "tspProblem.h"
+#include "tspTour.h"
+#include "twoLevelList.h"
+
+#define LOCAL_SEARCH_NEIGHBORS 10 // candidates per vertex when the problem has no neighbour lists
+
+// Buffers of the local search, kept between tours. Once they have held the largest
+// tour, improving tours allocates nothing. A zeroed one is empty.
+typedef struct {
+    int capacity; // vertices the buffers hold
+    TwoLevelList* tour;
+    int* queue;
+    char* queued;
+    int* neighbors; // the search's own lists when the problem has none
+    SpatialGrid grid;
+    int* order; // a linked tour as an array
+} LocalSearchBuffers;
+
+// Improve the closed tour order[0 .. numOfCoords - 1] in place until no 2-opt or
+// Or-opt move between nearest neighbours shortens it, or the time and move limits
+// in problem->options are reached. order[0] stays first, the direction may turn.
+// Returns the number of improving moves made, -1 on failure.
+long improveTour(const TspProblem* problem, int* order);
+
+// improveTour on a linked tour, which keeps its head
+long improveLinkedTour(const TspProblem* problem, TspTour* tour);
+
+// The same with buffers kept by the caller
+long improveTourWith(const TspProblem* problem, int* order, LocalSearchBuffers* buffers);
+long improveLinkedTourWith(const TspProblem* problem, TspTour* tour, LocalSearchBuffers* buffers);
+
+void releaseLocalSearch(LocalSearchBuffers* buffers);
+
+#endif
@@ -1,175 +1,60 @@
 // ompfInsertion.c
+// Command line of the OpenMP farthest insertion, see tspSolver.h. Build with
+// gcc -fopenmp ompfInsertion.c parallelFarthestInsertion.c batch.c tspProblem.c tspTour.c twoLevelList.c localSearch.c -o ompfInsertion -lm
 #include <stdio.h>
 #include <stdlib.h>
-#include <math.h>
-#include <float.h>
-#include <omp.h>
-
-#define MAX_COORDS 4096
-
-// Global variables
-double coords[MAX_COORDS][2];
-double distanceMatrix[MAX_COORDS][MAX_COORDS];
-int numOfCoords;
-int* tour;
-int* visited;
-int tourSize;
+#include <string.h>
+#include "tspSolver.h"
 
 // Function prototypes
-void readCoordinates(const char* filename);
-void calculateDistanceMatrix();
-void parallelFarthestInsertion(const char* outputFilename);
-void initializeTour();
-void cleanupTour();
+static int parallelFarthestInsertion(const TspProblem* problem, const char* outputFilename, void* workspace);
 
 int main(int argc, char* argv[]) {
-    if (argc != 3) {
-        printf("Usage: %s <coordinate_file_name> <output_file_name>\n", argv[0]);
+    TspOptions options;
+    if (argc < 3 || parseOptions(argc - 3, argv + 3, &options) != 0) {
+        printf("Usage: %s <coordinate_file_name> <output_file_name> [options]\n", argv[0]);
+        printf("       %s --batch <manifest_file_name> [options]\n", argv[0]);
+        printf("A manifest lists one \"<coordinate_file_name> <output_file_name>\" pair per line, - reads it from stdin.\n");
+        printOptionsUsage();
         return 1;
     }
+    if (strcmp(argv[1], "--batch") == 0) {
+        int failures = runBatch(argv[2], &options, parallelFarthestInsertion, sizeof(ParallelFarthestWorkspace),
+                                releaseParallelFarthestWorkspace);
+        return failures == 0 ? 0 : EXIT_FAILURE;
+    }
 
     const char* inputFilename = argv[1];
     const char* outputFilename = argv[2];
 
-    readCoordinates(inputFilename);
-    calculateDistanceMatrix();   
-    initializeTour();
-    parallelCheapestInsertion(outputFilename);
-    finalizeTour();
-    
-    return 0;
-}
-
-// Function to read coordinates from file and populate the coords array
-void readCoordinates(const char* filename) {
-    FILE* file = fopen(filename, "r");
-    if (file == NULL) {
-        perror("Error opening file");
-        exit(EXIT_FAILURE);
+    TspProblem* problem = readCoordinates(inputFilename);
+    if (!problem) {
+        return EXIT_FAILURE;
     }
-
-    numOfCoords = 0;
-    while (fscanf(file, "%lf,%lf", &coords[numOfCoords][0], &coords[numOfCoords][1]) == 2) {
-        numOfCoords++;
+    endPhase("read");
+    if (prepareDistances(problem, &options) != 0) {
+        freeProblem(problem);
+        return EXIT_FAILURE;
     }
+    endPhase("distances");
+    ParallelFarthestWorkspace workspace = { 0 };
+    int status = parallelFarthestInsertion(problem, outputFilename, &workspace);
+    releaseParallelFarthestWorkspace(&workspace);
+    freeProblem(problem);
 
-    fclose(file);
+    return status == 0 ? 0 : EXIT_FAILURE;
 }
 
-// Function to calculate the Euclidean distance between two points
-double euclideanDistance(double x1, double y1, double x2, double y2) {
-    return sqrt((x1 - x2) * (x1 - x2) + (y1 - y2) * (y1 - y2));
+// Build the tour with the workspace's buffers and write it, 0 on success and -1 on failure
+static int parallelFarthestInsertion(const TspProblem* problem, const char* outputFilename, void* workspace) {
+    ParallelFarthestWorkspace* buffers = workspace;
+    if (parallelFarthestInsertionTour(problem, buffers) != 0) {
+        return -1;
+    }
+    int numOfCoords = problem->numOfCoords;
+    toOriginalIds(problem, buffers->order, numOfCoords);
+    int status = problem->options.binaryOutput ? writeBinaryTourFile(outputFilename, buffers->order, numOfCoords)
+                                               : writeTourFile(outputFilename, buffers->order, numOfCoords);
+    endPhase("write");
+    return status;
 }
-
-// Function to generate the distance matrix from the coordinates
-void calculateDistanceMatrix() {
-    for (int i = 0; i < numOfCoords; i++) {
-        for (int j = 0; j < numOfCoords; j++) {
-            if (i == j) {
-                distanceMatrix[i][j] = 0.0;
-            } else {
-                distanceMatrix[i][j] = euclideanDistance(coords[i][0], coords[i][1], coords[j][0], coords[j][1]);
-            }
-        }
-    }
-}
-
-void initializeTour() {
-    // Allocate memory for the tour and visited arrays
-    tour = malloc(numOfCoords * sizeof(int));
-    visited = calloc(numOfCoords, sizeof(int)); // Calloc initializes the array to 0
-
-    if (!tour || !visited) {
-        fprintf(stderr, "Memory allocation failed.\n");
-        exit(EXIT_FAILURE);
-    }
-
-    // Starting vertex
-    tour[0] = 0;
-    visited[0] = 1; // Mark the first vertex as visited
-    tourSize = 1; // Start the tour with one vertex
-}
-
-void finalizeTour() {
-    // Free the allocated memory for tour and visited arrays
-    free(tour);
-    free(visited);
-}
-
-void parallelFarthestInsertion(const char* outputFilename) {
-    // Start with the two farthest vertices
-    // Implement the initialization of the tour with two farthest vertices
-
-    while (tourSize < numOfCoords) {
-        double maxDist = 0;
-        int farthestVertex = -1;
-        int insertPosition = -1;
-
-        // Parallelize the search for the farthest unvisited vertex
-        #pragma omp parallel
-        {
-            double localMaxDist = 0;
-            int localFarthestVertex = -1;
-            int localInsertPosition = -1;
-
-            #pragma omp for nowait
-            for (int i = 0; i < numOfCoords; i++) {
-                if (!visited[i]) {
-                    double distToTour = 0;
-                    // Find distance from vertex i to the nearest vertex in the tour
-                    for (int j = 0; j < tourSize; j++) {
-                        double dist = distanceMatrix[i][tour[j]];
-                        if (dist > distToTour) {
-                            distToTour = dist;
-                        }
-                    }
-                    if (distToTour > localMaxDist) {
-                        localMaxDist = distToTour;
-                        localFarthestVertex = i;
-                    }
-                }
-            }
-
-            // Critical section to update the global maximum distance
-            #pragma omp critical
-            {
-                if (localMaxDist > maxDist) {
-                    maxDist = localMaxDist;
-                    farthestVertex = localFarthestVertex;
-                }
-            }
-        }
-
-        // Find the best position to insert the farthest vertex
-        // This part remains sequential due to dependency on tour order
-        double minIncrease = DBL_MAX;
-        for (int i = 0; i < tourSize; i++) {
-            int next = (i + 1) % tourSize;
-            double increase = distanceMatrix[tour[i]][farthestVertex] + distanceMatrix[farthestVertex][tour[next]] - distanceMatrix[tour[i]][tour[next]];
-            if (increase < minIncrease) {
-                minIncrease = increase;
-                insertPosition = next;
-            }
-        }
-
-        // Insert the farthest vertex into the tour
-        for (int i = tourSize; i > insertPosition; i--) {
-            tour[i] = tour[i - 1];
-        }
-        tour[insertPosition] = farthestVertex;
-        visited[farthestVertex] = 1;
-        tourSize++;
-    }
-
-    // Write the tour to the output file
-    FILE* file = fopen(outputFilename, "w");
-    if (file == NULL) {
-        perror("Error opening output file");
-        exit(EXIT_FAILURE);
-    }
-    for (int i = 0; i < numOfCoords; i++) {
-        fprintf(file, "%d\n", tour[i]);
-    }
-    fclose(file);
-}
-
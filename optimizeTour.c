@@ -0,0 +1,70 @@
+// optimizeTour.c
+// Improve an existing tour with the solvers' 2-opt and Or-opt local search, e.g.
+// a tour written by a solver without --optimize. Build with
+// gcc optimizeTour.c tspProblem.c tspTour.c twoLevelList.c localSearch.c -o optimizeTour -lm
+#include <stdio.h>
+#include <stdlib.h>
+#include "tspProblem.h"
+#include "tspTour.h"
+#include "localSearch.h"
+
+int main(int argc, char* argv[]) {
+    TspOptions options;
+    if (argc < 4 || parseOptions(argc - 4, argv + 4, &options) != 0) {
+        printf("Usage: %s <coordinate_file_name> <tour_file_name> <output_file_name> [options]\n", argv[0]);
+        printOptionsUsage();
+        return 1;
+    }
+
+    const char* inputFilename = argv[1];
+    const char* tourFilename = argv[2];
+    const char* outputFilename = argv[3];
+
+    TspProblem* problem = readCoordinates(inputFilename);
+    if (!problem) {
+        return EXIT_FAILURE;
+    }
+    endPhase("read");
+    if (prepareDistances(problem, &options) != 0) {
+        freeProblem(problem);
+        return EXIT_FAILURE;
+    }
+    endPhase("distances");
+
+    int* order = malloc(problem->numOfCoords * sizeof(int));
+    if (!order) {
+        perror("Memory allocation for tour failed");
+        freeProblem(problem);
+        return EXIT_FAILURE;
+    }
+    if (readTourFile(tourFilename, problem->numOfCoords, order) != 0) {
+        free(order);
+        freeProblem(problem);
+        return EXIT_FAILURE;
+    }
+    toReorderedIds(problem, order, problem->numOfCoords);
+    endPhase("construction");
+
+    double initialCost = tourLength(problem, order);
+    long moves = improveTour(problem, order);
+    if (moves < 0) {
+        free(order);
+        freeProblem(problem);
+        return EXIT_FAILURE;
+    }
+    endPhase("optimization");
+
+    double finalCost = tourLength(problem, order);
+    toOriginalIds(problem, order, problem->numOfCoords);
+    int status = writeTourFile(outputFilename, order, problem->numOfCoords);
+    endPhase("write");
+    if (status == 0) {
+        printf("Initial cost: %f\n", initialCost);
+        printf("Final cost: %f\n", finalCost);
+        printf("Improving moves: %ld\n", moves);
+    }
+
+    free(order);
+    freeProblem(problem);
+    return status == 0 ? 0 : EXIT_FAILURE;
+}
@@ -0,0 +1,361 @@
+// parallelCheapestInsertion.c
+// Cheapest insertion shared by an OpenMP team: every round the threads refresh the
+// cached cheapest edges of their blocks of vertices and list their cheapest vertices,
+// and one thread merges the lists and inserts up to --insert-batch of them.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include "tspSolver.h"
+
+// One team builds the whole tour, a thread works on the same blocks every pass
+#ifdef _OPENMP
+#include <omp.h>
+#define PARALLEL_TEAM _Pragma("omp parallel")
+#define BLOCKS_LOOP _Pragma("omp for schedule(static)")
+#define BLOCKS_LOOP_NOWAIT _Pragma("omp for schedule(static) nowait")
+#define TEAM_BARRIER _Pragma("omp barrier")
+#define MERGE_SECTION _Pragma("omp single")
+#define COUNTS_UPDATE _Pragma("omp atomic")
+#define THREAD_NUM omp_get_thread_num()
+#define NUM_THREADS omp_get_num_threads()
+#define MAX_THREADS omp_get_max_threads()
+#else
+#define PARALLEL_TEAM
+#define BLOCKS_LOOP
+#define BLOCKS_LOOP_NOWAIT
+#define TEAM_BARRIER
+#define MERGE_SECTION
+#define COUNTS_UPDATE
+#define THREAD_NUM 0
+#define NUM_THREADS 1
+#define MAX_THREADS 1
+#endif
+
+// An unvisited vertex and the increase of inserting it on its cached edge
+typedef struct {
+    double increase;
+    int vertex;
+} InsertionCandidate;
+
+// Function prototypes
+static int reserveWorkspace(ParallelCheapestWorkspace* workspace, int numOfCoords);
+static int reserveRounds(ParallelCheapestWorkspace* workspace, int batch, int numThreads);
+static void offerCandidate(InsertionCandidate* list, int* size, int capacity, double increase, int vertex);
+static int compareCandidates(const void* a, const void* b);
+
+// Grow the workspace to numOfCoords vertices, 0 on success and -1 on failure
+static int reserveWorkspace(ParallelCheapestWorkspace* workspace, int numOfCoords) {
+    if (numOfCoords <= workspace->capacity) {
+        return 0;
+    }
+    freeTour(workspace->tour);
+    free(workspace->visited);
+    free(workspace->bestFrom);
+    free(workspace->bestIncrease);
+    free(workspace->split);
+    free(workspace->order);
+    workspace->capacity = 0;
+
+    // Linked tour, its order index orders tied edges by their place in the tour
+    workspace->tour = createTour(numOfCoords, 1);
+    workspace->visited = malloc(numOfCoords * sizeof(int));
+    workspace->bestFrom = malloc(numOfCoords * sizeof(int));
+    workspace->bestIncrease = malloc(numOfCoords * sizeof(double));
+    workspace->split = malloc(numOfCoords * sizeof(char));
+    workspace->order = malloc(numOfCoords * sizeof(int));
+    if (!workspace->tour || !workspace->visited || !workspace->bestFrom || !workspace->bestIncrease ||
+        !workspace->split || !workspace->order) {
+        perror("Memory allocation for insertion cache failed");
+        releaseParallelCheapestWorkspace(workspace);
+        return -1;
+    }
+    workspace->capacity = numOfCoords;
+    return 0;
+}
+
+// Grow the rounds to batch vertices and the lists to numThreads threads, 0 on success
+// and -1 on failure
+static int reserveRounds(ParallelCheapestWorkspace* workspace, int batch, int numThreads) {
+    if (batch <= workspace->roundCapacity && numThreads <= workspace->numThreads) {
+        return 0;
+    }
+    batch = batch > workspace->roundCapacity ? batch : workspace->roundCapacity;
+    numThreads = numThreads > workspace->numThreads ? numThreads : workspace->numThreads;
+    free(workspace->roundFrom);
+    free(workspace->roundVertex);
+    free(workspace->roundTo);
+    free(workspace->lists);
+    free(workspace->listSizes);
+    free(workspace->merged);
+    free(workspace->busy);
+    workspace->roundCapacity = 0;
+    workspace->numThreads = 0;
+
+    // Each thread's list starts on a cache line of its own
+    int stride = (batch * sizeof(InsertionCandidate) + 63) / 64 * 64 / sizeof(InsertionCandidate);
+    workspace->roundFrom = malloc(batch * sizeof(int));
+    workspace->roundVertex = malloc(batch * sizeof(int));
+    workspace->roundTo = malloc(batch * sizeof(int));
+    workspace->lists = aligned_alloc(64, (size_t)numThreads * stride * sizeof(InsertionCandidate));
+    workspace->listSizes = malloc(numThreads * sizeof(int));
+    workspace->merged = malloc((size_t)numThreads * batch * sizeof(InsertionCandidate));
+    workspace->busy = malloc(numThreads * sizeof(double));
+    if (!workspace->roundFrom || !workspace->roundVertex || !workspace->roundTo || !workspace->lists ||
+        !workspace->listSizes || !workspace->merged || !workspace->busy) {
+        perror("Memory allocation for insertion rounds failed");
+        releaseParallelCheapestWorkspace(workspace);
+        return -1;
+    }
+    workspace->roundCapacity = batch;
+    workspace->numThreads = numThreads;
+    workspace->listStride = stride;
+    return 0;
+}
+
+void releaseParallelCheapestWorkspace(void* workspace) {
+    ParallelCheapestWorkspace* buffers = workspace;
+    freeTour(buffers->tour);
+    free(buffers->visited);
+    free(buffers->bestFrom);
+    free(buffers->bestIncrease);
+    free(buffers->split);
+    free(buffers->order);
+    free(buffers->roundFrom);
+    free(buffers->roundVertex);
+    free(buffers->roundTo);
+    free(buffers->lists);
+    free(buffers->listSizes);
+    free(buffers->merged);
+    free(buffers->busy);
+    releaseLocalSearch(&buffers->search);
+    memset(buffers, 0, sizeof(ParallelCheapestWorkspace));
+}
+
+int parallelCheapestInsertionTour(const TspProblem* problem, ParallelCheapestWorkspace* buffers) {
+    int numOfCoords = problem->numOfCoords;
+    int batch = problem->options.insertBatch;
+    double tolerance = problem->options.insertTolerance;
+    if (reserveWorkspace(buffers, numOfCoords) != 0 || reserveRounds(buffers, batch, MAX_THREADS) != 0) {
+        return -1;
+    }
+    TspTour* tour = buffers->tour;
+    int* visited = buffers->visited;
+    int* bestFrom = buffers->bestFrom;
+    double* bestIncrease = buffers->bestIncrease;
+    memset(visited, 0, numOfCoords * sizeof(int));
+
+    // Start with vertex 0 in the tour
+    startTour(tour, 0);
+    visited[0] = 1;
+
+    // Each round inserts up to batch vertices on distinct edges, one when batch is 1.
+    // Round vertex j split the edge (roundFrom[j], roundTo[j]), and split[v] marks
+    // the vertices v whose outgoing edge a round split.
+    int roundSize = 0;
+    int* roundFrom = buffers->roundFrom;
+    int* roundVertex = buffers->roundVertex;
+    int* roundTo = buffers->roundTo;
+    char* split = buffers->split;
+    memset(split, 0, numOfCoords * sizeof(char));
+
+    // Per-thread lists of the batch cheapest vertices, merged by a single thread after every pass
+    int stride = buffers->listStride;
+    InsertionCandidate* lists = buffers->lists;
+    int* listSizes = buffers->listSizes;
+    InsertionCandidate* merged = buffers->merged;
+
+    // Counts and busy times for --stats, summed over the team once it is done
+    int stats = statsEnabled();
+    double* threadBusy = buffers->busy;
+    memset(threadBusy, 0, buffers->numThreads * sizeof(double));
+    long steps = 0;
+    long rounds = 0;
+    long candidates = 0;
+    double teamStart = wallTime();
+
+    // One team builds the whole tour. Every pass splits the vertex blocks with the
+    // same static schedule, so a thread keeps the slice of the cache it touched
+    // first and, with OMP_PROC_BIND set, that slice stays on its NUMA node.
+    PARALLEL_TEAM
+    {
+        int thread = THREAD_NUM;
+        double increases[SCORE_BLOCK];
+        InsertionCandidate* list = lists + (size_t)thread * stride;
+        long threadCandidates = 0;
+        double busy = 0.0; // time in its share of the loops, the rest goes to barriers and merges
+        double passStart = stats ? wallTime() : 0.0;
+
+        // With a single vertex the only edge is the loop 0 -> 0
+        BLOCKS_LOOP
+        for (int first = 0; first < numOfCoords; first += SCORE_BLOCK) {
+            int count = numOfCoords - first < SCORE_BLOCK ? numOfCoords - first : SCORE_BLOCK;
+            for (int i = first; i < first + count; ++i) {
+                bestFrom[i] = 0;
+                bestIncrease[i] = getDistance(problem, 0, i) + getDistance(problem, i, 0) - getDistance(problem, 0, 0);
+            }
+            threadCandidates += count;
+        }
+        if (stats) {
+            busy += wallTime() - passStart;
+        }
+
+        // Complete the tour
+        while (tour->size < numOfCoords) {
+            int listSize = 0;
+            if (stats) {
+                passStart = wallTime();
+            }
+
+            // Refresh the cached cheapest edge of every unvisited vertex and find the
+            // cheapest vertices to insert in the same pass, scoring each new edge
+            // against whole blocks of candidates
+            BLOCKS_LOOP_NOWAIT
+            for (int first = 0; first < numOfCoords; first += SCORE_BLOCK) {
+                int count = numOfCoords - first < SCORE_BLOCK ? numOfCoords - first : SCORE_BLOCK;
+
+                // A vertex whose cached edge was split rescans the whole tour
+                for (int i = first; i < first + count; ++i) {
+                    if (visited[i] || roundSize == 0 || !split[bestFrom[i]]) {
+                        continue;
+                    }
+                    bestIncrease[i] = DBL_MAX;
+                    threadCandidates += tour->size;
+                    int current = tour->head;
+                    for (int j = 0; j < tour->size; ++j, current = tour->next[current]) {
+                        int next = tour->next[current];
+                        double increase = getDistance(problem, current, i) + getDistance(problem, i, next) - getDistance(problem, current, next);
+                        if (increase < bestIncrease[i]) {
+                            bestIncrease[i] = increase;
+                            bestFrom[i] = current;
+                        }
+                    }
+                }
+
+                // Only the new edges can beat the others' cached edges; ties go to
+                // the edge earlier in the tour, as in a full rescan
+                for (int e = 0; e < 2 * roundSize; ++e) {
+                    int a = e % 2 == 0 ? roundFrom[e / 2] : roundVertex[e / 2];
+                    int b = e % 2 == 0 ? roundVertex[e / 2] : roundTo[e / 2];
+                    insertionCosts(problem, a, b, first, count, increases);
+                    threadCandidates += count;
+                    for (int i = first; i < first + count; ++i) {
+                        double increase = increases[i - first];
+                        if (!visited[i] && (increase < bestIncrease[i] ||
+                            (increase == bestIncrease[i] && tourPrecedes(tour, a, bestFrom[i])))) {
+                            bestIncrease[i] = increase;
+                            bestFrom[i] = a;
+                        }
+                    }
+                }
+
+                for (int i = first; i < first + count; ++i) {
+                    if (!visited[i]) {
+                        offerCandidate(list, &listSize, batch, bestIncrease[i], i);
+                    }
+                }
+            }
+
+            if (stats) {
+                busy += wallTime() - passStart;
+            }
+            listSizes[thread] = listSize;
+            TEAM_BARRIER
+
+            // One thread merges the lists, ties go to the lowest vertex, and inserts
+            // the cheapest vertex and the next cheapest within the tolerance of it
+            // whose edges are still whole. The barrier closing the single publishes
+            // the new tour to the team.
+            MERGE_SECTION
+            {
+                int numMerged = 0;
+                for (int t = 0; t < NUM_THREADS; t++) {
+                    memcpy(merged + numMerged, lists + (size_t)t * stride, listSizes[t] * sizeof(InsertionCandidate));
+                    numMerged += listSizes[t];
+                }
+                qsort(merged, numMerged, sizeof(InsertionCandidate), compareCandidates);
+
+                for (int j = 0; j < roundSize; j++) {
+                    split[roundFrom[j]] = 0;
+                }
+                roundSize = 0;
+                double limit = merged[0].increase + tolerance * fabs(merged[0].increase);
+                for (int c = 0; c < numMerged && roundSize < batch && merged[c].increase <= limit; c++) {
+                    int v = merged[c].vertex;
+                    int from = bestFrom[v];
+                    if (split[from]) {
+                        continue;
+                    }
+                    // Insert the vertex into the tour in O(1), splitting the closing
+                    // edge makes it the new first vertex
+                    int to = tour->next[from];
+                    insertBefore(tour, to, v);
+                    visited[v] = 1;
+                    split[from] = 1;
+                    roundFrom[roundSize] = from;
+                    roundVertex[roundSize] = v;
+                    roundTo[roundSize] = to;
+                    roundSize++;
+                }
+                steps += roundSize;
+                rounds++;
+            }
+        }
+
+        COUNTS_UPDATE
+        candidates += threadCandidates;
+        threadBusy[thread] = busy;
+    }
+    addCount(COUNT_STEPS, steps);
+    addCount(COUNT_ROUNDS, rounds);
+    addCount(COUNT_CANDIDATES, candidates);
+    if (stats) {
+        for (int t = 0; t < buffers->numThreads; t++) {
+            addThreadBusy(t, threadBusy[t]);
+        }
+        addParallelTime(wallTime() - teamStart);
+    }
+    endPhase("construction");
+
+    // Shorten the tour with 2-opt and Or-opt, the constructed tour is kept if that fails
+    if (problem->options.optimize) {
+        improveLinkedTourWith(problem, tour, &buffers->search);
+        endPhase("optimization");
+    }
+
+    // Written from the head in the format of cInsertion
+    tourToArray(tour, buffers->order);
+    return 0;
+}
+
+// Add the vertex to a list of the capacity cheapest candidates, kept sorted by
+// increase with ties to the lowest vertex
+static void offerCandidate(InsertionCandidate* list, int* size, int capacity, double increase, int vertex) {
+    int slot = *size;
+    if (slot == capacity) {
+        if (increase > list[slot - 1].increase ||
+            (increase == list[slot - 1].increase && vertex > list[slot - 1].vertex)) {
+            return;
+        }
+        slot--;
+    } else {
+        (*size)++;
+    }
+    while (slot > 0 && (increase < list[slot - 1].increase ||
+                        (increase == list[slot - 1].increase && vertex < list[slot - 1].vertex))) {
+        list[slot] = list[slot - 1];
+        slot--;
+    }
+    list[slot].increase = increase;
+    list[slot].vertex = vertex;
+}
+
+static int compareCandidates(const void* a, const void* b) {
+    const InsertionCandidate* x = a;
+    const InsertionCandidate* y = b;
+    if (x->increase != y->increase) {
+        return x->increase < y->increase ? -1 : 1;
+    }
+    return (x->vertex > y->vertex) - (x->vertex < y->vertex);
+}
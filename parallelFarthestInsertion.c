@@ -0,0 +1,242 @@
+// parallelFarthestInsertion.c
+// Farthest insertion shared by an OpenMP team: every step the threads fold the last
+// inserted vertex into their blocks' distances to the tour while finding the farthest
+// vertex, and try the tour edges for it when no neighbour list narrows them down.
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include "tspSolver.h"
+
+// Best vertex so far in the farthest vertex search
+typedef struct {
+    double distance;
+    int vertex;
+} FarthestCandidate;
+
+// Best edge so far in the insertion edge search, the edge leaving tour vertex from
+typedef struct {
+    double increase;
+    uint64_t order; // order label of from, earlier edges win ties
+    int from;
+} EdgeCandidate;
+
+// The farther vertex wins, ties go to the lowest id as in fInsertion.c
+static inline FarthestCandidate fartherOf(FarthestCandidate a, FarthestCandidate b) {
+    if (b.distance > a.distance || (b.distance == a.distance && b.vertex < a.vertex)) {
+        return b;
+    }
+    return a;
+}
+
+// The cheaper edge wins, ties go to the edge earlier in the tour as in fInsertion.c.
+// Any edge beats no edge, even when its increase overflowed to inf or NaN.
+static inline EdgeCandidate cheaperOf(EdgeCandidate a, EdgeCandidate b) {
+    if (b.from >= 0 && (a.from < 0 || b.increase < a.increase || (b.increase == a.increase && b.order < a.order))) {
+        return b;
+    }
+    return a;
+}
+
+// Argmax and argmin reductions merge the per-thread candidates without a critical section
+#ifdef _OPENMP
+#include <omp.h>
+#pragma omp declare reduction(farthest : FarthestCandidate : omp_out = fartherOf(omp_out, omp_in)) \
+    initializer(omp_priv = (FarthestCandidate){ -1.0, INT32_MAX })
+#pragma omp declare reduction(cheapest : EdgeCandidate : omp_out = cheaperOf(omp_out, omp_in)) \
+    initializer(omp_priv = (EdgeCandidate){ DBL_MAX, UINT64_MAX, -1 })
+#define FARTHEST_REGION _Pragma("omp parallel reduction(farthest : farthest)")
+#define CHEAPEST_REGION _Pragma("omp parallel reduction(cheapest : best)")
+#define VERTEX_LOOP _Pragma("omp for schedule(static) nowait")
+#define THREAD_NUM omp_get_thread_num()
+#define MAX_THREADS omp_get_max_threads()
+#else
+#define FARTHEST_REGION
+#define CHEAPEST_REGION
+#define VERTEX_LOOP
+#define THREAD_NUM 0
+#define MAX_THREADS 1
+#endif
+
+// Grow the workspace to numOfCoords vertices, 0 on success and -1 on failure
+static int reserveWorkspace(ParallelFarthestWorkspace* workspace, int numOfCoords) {
+    if (numOfCoords <= workspace->capacity) {
+        return 0;
+    }
+    releaseParallelFarthestWorkspace(workspace);
+
+    // Linked tour, its order index orders tied edges by their place in the tour
+    workspace->tour = createTour(numOfCoords, 1);
+    if (!workspace->tour) {
+        return -1;
+    }
+    workspace->visited = malloc(numOfCoords * sizeof(int));
+    workspace->minDistance = malloc(numOfCoords * sizeof(double));
+    workspace->order = malloc(numOfCoords * sizeof(int));
+    if (!workspace->visited || !workspace->minDistance || !workspace->order) {
+        perror("Memory allocation for farthest insertion failed");
+        releaseParallelFarthestWorkspace(workspace);
+        return -1;
+    }
+    workspace->capacity = numOfCoords;
+    return 0;
+}
+
+// Grow the busy times to numThreads threads, 0 on success and -1 on failure
+static int reserveTeam(ParallelFarthestWorkspace* workspace, int numThreads) {
+    if (numThreads <= workspace->numThreads) {
+        return 0;
+    }
+    free(workspace->busy);
+    workspace->busy = malloc(numThreads * sizeof(double));
+    if (!workspace->busy) {
+        perror("Memory allocation for thread times failed");
+        workspace->numThreads = 0;
+        return -1;
+    }
+    workspace->numThreads = numThreads;
+    return 0;
+}
+
+void releaseParallelFarthestWorkspace(void* workspace) {
+    ParallelFarthestWorkspace* buffers = workspace;
+    freeTour(buffers->tour);
+    free(buffers->visited);
+    free(buffers->minDistance);
+    free(buffers->order);
+    free(buffers->busy);
+    releaseLocalSearch(&buffers->search);
+    memset(buffers, 0, sizeof(ParallelFarthestWorkspace));
+}
+
+int parallelFarthestInsertionTour(const TspProblem* problem, ParallelFarthestWorkspace* buffers) {
+    int numOfCoords = problem->numOfCoords;
+    if (reserveWorkspace(buffers, numOfCoords) != 0 || reserveTeam(buffers, MAX_THREADS) != 0) {
+        return -1;
+    }
+    TspTour* tour = buffers->tour;
+    int* visited = buffers->visited;
+    double* minDistance = buffers->minDistance;
+    memset(visited, 0, numOfCoords * sizeof(int));
+    for (int i = 0; i < numOfCoords; i++) {
+        minDistance[i] = DBL_MAX;
+    }
+
+    // Start with vertex 0 in the tour
+    startTour(tour, 0);
+    visited[0] = 1;
+
+    int inserted = 0; // Vertex added to the tour last
+    int stats = statsEnabled();
+    double* threadBusy = buffers->busy; // summed over the construction, reported once it is done
+    memset(threadBusy, 0, buffers->numThreads * sizeof(double));
+    while (tour->size < numOfCoords) {
+        FarthestCandidate farthest = { -1.0, INT32_MAX };
+
+        // Fold the last inserted vertex into every distance to the tour in parallel,
+        // and find the unvisited vertex farthest from the tour in the same pass. With
+        // --stats each thread times its share, the rest of the region is idle.
+        double regionStart = stats ? wallTime() : 0.0;
+        FARTHEST_REGION
+        {
+            double loopStart = stats ? wallTime() : 0.0;
+            VERTEX_LOOP
+            for (int first = 0; first < numOfCoords; first += SCORE_BLOCK) {
+                int count = numOfCoords - first < SCORE_BLOCK ? numOfCoords - first : SCORE_BLOCK;
+                double dists[SCORE_BLOCK];
+                distancesFrom(problem, inserted, first, count, dists);
+                for (int i = first; i < first + count; i++) {
+                    if (visited[i]) {
+                        continue;
+                    }
+                    if (dists[i - first] < minDistance[i]) {
+                        minDistance[i] = dists[i - first];
+                    }
+                    FarthestCandidate candidate = { minDistance[i], i };
+                    farthest = fartherOf(farthest, candidate);
+                }
+            }
+            if (stats) {
+                threadBusy[THREAD_NUM] += wallTime() - loopStart;
+            }
+        }
+        if (stats) {
+            addParallelTime(wallTime() - regionStart);
+        }
+        addCount(COUNT_DISTANCES, numOfCoords);
+        int vertex = farthest.vertex;
+
+        // Find the best edge to insert the farthest vertex on. Its visited
+        // neighbours give a handful of edges that are cheaper to try serially;
+        // without any, every tour edge is tried in parallel by its first vertex.
+        EdgeCandidate best = { DBL_MAX, UINT64_MAX, -1 };
+        const int* neighbors = problem->numNeighbors > 0 ? neighborsOf(problem, vertex) : NULL;
+        for (int m = 0; m < problem->numNeighbors; m++) {
+            int u = neighbors[m];
+            if (!visited[u]) {
+                continue;
+            }
+            int edges[2] = { tour->prev[u], u };
+            addCount(COUNT_CANDIDATES, 2);
+            for (int e = 0; e < 2; e++) {
+                int from = edges[e];
+                int next = tour->next[from];
+                EdgeCandidate candidate = {
+                    getDistance(problem, from, vertex) + getDistance(problem, vertex, next) - getDistance(problem, from, next),
+                    tour->label[from], from
+                };
+                best = cheaperOf(best, candidate);
+            }
+        }
+        if (best.from < 0) {
+            double regionStart = stats ? wallTime() : 0.0;
+            CHEAPEST_REGION
+            {
+                double loopStart = stats ? wallTime() : 0.0;
+                VERTEX_LOOP
+                for (int from = 0; from < numOfCoords; from++) {
+                    if (!visited[from]) {
+                        continue;
+                    }
+                    int next = tour->next[from];
+                    EdgeCandidate candidate = {
+                        getDistance(problem, from, vertex) + getDistance(problem, vertex, next) - getDistance(problem, from, next),
+                        tour->label[from], from
+                    };
+                    best = cheaperOf(best, candidate);
+                }
+                if (stats) {
+                    threadBusy[THREAD_NUM] += wallTime() - loopStart;
+                }
+            }
+            if (stats) {
+                addParallelTime(wallTime() - regionStart);
+            }
+            addCount(COUNT_CANDIDATES, tour->size);
+        }
+
+        // Insert the farthest vertex into the tour
+        insertAfter(tour, best.from, vertex);
+        visited[vertex] = 1;
+        inserted = vertex;
+        addCount(COUNT_STEPS, 1);
+    }
+    if (stats) {
+        for (int t = 0; t < buffers->numThreads; t++) {
+            addThreadBusy(t, threadBusy[t]);
+        }
+    }
+    endPhase("construction");
+
+    // Shorten the tour with 2-opt and Or-opt, the constructed tour is kept if that fails
+    if (problem->options.optimize) {
+        improveLinkedTourWith(problem, tour, &buffers->search);
+        endPhase("optimization");
+    }
+
+    // Written from the head, starting and ending with 0 as fInsertion.c does
+    tourToArray(tour, buffers->order);
+    return 0;
+}
@@ -0,0 +1,2131 @@
+// tspProblem.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <float.h>
+#include <math.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "tspProblem.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define TSP_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+// Spread the distance table builders and the input parsing over the OpenMP team when there is one
+#ifdef _OPENMP
+#include <omp.h>
+#define PARALLEL_TILE_LOOP _Pragma("omp parallel for schedule(dynamic)")
+#define PARALLEL_CHUNK_LOOP _Pragma("omp parallel for schedule(static, 1)")
+#define TILE_THREAD omp_get_thread_num()
+#define MAX_TILE_THREADS omp_get_max_threads()
+#else
+#define PARALLEL_TILE_LOOP
+#define PARALLEL_CHUNK_LOOP
+#define TILE_THREAD 0
+#define MAX_TILE_THREADS 1
+#endif
+
+#define PARALLEL_PARSE_BYTES (4 << 20) // Inputs at least this large are parsed by the whole team
+
+static void onTheFlyDistances(const TspProblem* problem, int v, int first, int count, double* out);
+static void tourEdgeLengths(const TspProblem* problem, const int* order, int first, int count, double* out);
+
+// Phase timer state, set up by parseOptions(). Each thread times its own phases.
+static int reportTimings = 0;
+static _Thread_local double phaseStart = 0.0;
+
+// --stats state. Like the counts, the busy and parallel times belong to the thread
+// running the phase, so batch workers each report their own instance.
+#define MAX_STAT_THREADS 256
+static int reportStats = 0;
+_Thread_local long phaseCounts[COUNT_KINDS];
+static const char* const countNames[COUNT_KINDS] = { "steps", "candidates", "distances", "moves", "starts", "rounds" };
+static _Thread_local double threadBusy[MAX_STAT_THREADS];
+static _Thread_local double parallelTime = 0.0;
+
+// --perf state, one counter per event over the whole process, the threads it
+// starts later included
+#define PERF_EVENTS 4
+static int reportPerf = 0;
+static int perfFds[PERF_EVENTS] = { -1, -1, -1, -1 };
+static const char* const perfNames[PERF_EVENTS] = { "cycles", "instructions", "cache_references", "cache_misses" };
+static _Thread_local uint64_t perfLast[PERF_EVENTS];
+
+double wallTime(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+// Open the hardware counters before any other thread starts, so they inherit them.
+// Returns 0, or -1 after reporting why there are none.
+static int openPerfCounters(void) {
+#ifdef __linux__
+    static const uint64_t configs[PERF_EVENTS] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_REFERENCES, PERF_COUNT_HW_CACHE_MISSES
+    };
+    for (int e = 0; e < PERF_EVENTS; e++) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = configs[e];
+        attr.inherit = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        perfFds[e] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        if (perfFds[e] < 0) {
+            fprintf(stderr, "perf unavailable: %s\n", strerror(errno));
+            for (int f = 0; f < e; f++) {
+                close(perfFds[f]);
+                perfFds[f] = -1;
+            }
+            return -1;
+        }
+    }
+    return 0;
+#else
+    fprintf(stderr, "perf unavailable: hardware counters need Linux\n");
+    return -1;
+#endif
+}
+
+static void readPerfCounters(uint64_t values[PERF_EVENTS]) {
+    for (int e = 0; e < PERF_EVENTS; e++) {
+        values[e] = 0;
+        if (perfFds[e] >= 0 && read(perfFds[e], &values[e], sizeof(values[e])) != sizeof(values[e])) {
+            values[e] = 0;
+        }
+    }
+}
+
+void endPhase(const char* name) {
+    double now = wallTime();
+    if (reportTimings) {
+        fprintf(stderr, "phase %s %.6f\n", name, now - phaseStart);
+    }
+    if (reportStats) {
+        for (int c = 0; c < COUNT_KINDS; c++) {
+            if (phaseCounts[c] != 0) {
+                fprintf(stderr, "counter %s %s %ld\n", name, countNames[c], phaseCounts[c]);
+            }
+        }
+        if (phaseCounts[COUNT_STEPS] > 0 && phaseCounts[COUNT_CANDIDATES] > 0) {
+            fprintf(stderr, "counter %s candidates_per_step %.2f\n", name,
+                    (double)phaseCounts[COUNT_CANDIDATES] / phaseCounts[COUNT_STEPS]);
+        }
+        if (parallelTime > 0.0) {
+            for (int t = 0; t < MAX_STAT_THREADS; t++) {
+                if (threadBusy[t] > 0.0) {
+                    fprintf(stderr, "thread %s %d %.6f %.6f\n", name, t, threadBusy[t], parallelTime - threadBusy[t]);
+                }
+                threadBusy[t] = 0.0;
+            }
+            parallelTime = 0.0;
+        }
+    }
+    if (reportPerf) {
+        uint64_t values[PERF_EVENTS];
+        readPerfCounters(values);
+        for (int e = 0; e < PERF_EVENTS; e++) {
+            fprintf(stderr, "perf %s %s %llu\n", name, perfNames[e], (unsigned long long)(values[e] - perfLast[e]));
+        }
+        if (values[0] > perfLast[0]) {
+            fprintf(stderr, "perf %s ipc %.3f\n", name, (double)(values[1] - perfLast[1]) / (values[0] - perfLast[0]));
+        }
+        memcpy(perfLast, values, sizeof(perfLast));
+    }
+    memset(phaseCounts, 0, sizeof(phaseCounts));
+    phaseStart = now;
+}
+
+void startPhases(void) {
+    memset(phaseCounts, 0, sizeof(phaseCounts));
+    memset(threadBusy, 0, sizeof(threadBusy));
+    parallelTime = 0.0;
+    if (reportPerf) {
+        readPerfCounters(perfLast);
+    }
+    phaseStart = wallTime();
+}
+
+int statsEnabled(void) {
+    return reportStats;
+}
+
+void addThreadBusy(int thread, double seconds) {
+    if (thread >= 0 && thread < MAX_STAT_THREADS) {
+        threadBusy[thread] += seconds;
+    }
+}
+
+void addParallelTime(double seconds) {
+    parallelTime += seconds;
+}
+
+// Options accepted after the file names
+void defaultOptions(TspOptions* options) {
+    options->distanceMode = DISTANCES_MATRIX;
+    options->metric = METRIC_EUCLIDEAN;
+    options->useFloat = 0;
+    options->numNeighbors = 0;
+    options->optimize = 0;
+    options->timeLimit = 0.0;
+    options->maxMoves = 0;
+    options->binaryOutput = 0;
+    options->hilbertOrder = 0;
+    options->numStarts = 1;
+    options->startTimeLimit = 0.0;
+    options->insertBatch = 1;
+    options->insertTolerance = 0.25;
+    options->partitionSize = 0;
+}
+
+int parseOptions(int argc, char* argv[], TspOptions* options) {
+    defaultOptions(options);
+    phaseStart = wallTime();
+
+    for (int i = 0; i < argc; i++) {
+        if (strcmp(argv[i], "--distances=matrix") == 0) {
+            options->distanceMode = DISTANCES_MATRIX;
+        } else if (strcmp(argv[i], "--distances=packed") == 0) {
+            options->distanceMode = DISTANCES_PACKED;
+        } else if (strcmp(argv[i], "--distances=none") == 0) {
+            options->distanceMode = DISTANCES_NONE;
+        } else if (strcmp(argv[i], "--metric=euclidean") == 0) {
+            options->metric = METRIC_EUCLIDEAN;
+        } else if (strcmp(argv[i], "--metric=squared") == 0) {
+            options->metric = METRIC_SQUARED;
+        } else if (strcmp(argv[i], "--metric=manhattan") == 0) {
+            options->metric = METRIC_MANHATTAN;
+        } else if (strcmp(argv[i], "--metric=haversine") == 0) {
+            options->metric = METRIC_HAVERSINE;
+        } else if (strcmp(argv[i], "--float") == 0) {
+            options->useFloat = 1;
+        } else if (strncmp(argv[i], "--neighbors=", 12) == 0) {
+            char* end;
+            long k = strtol(argv[i] + 12, &end, 10);
+            if (end == argv[i] + 12 || *end != '\0' || k < 0 || k > MAX_COORDS) {
+                fprintf(stderr, "Invalid neighbour count: %s\n", argv[i]);
+                return -1;
+            }
+            options->numNeighbors = (int)k;
+        } else if (strcmp(argv[i], "--timings") == 0) {
+            reportTimings = 1;
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            reportTimings = 1;
+            reportStats = 1;
+        } else if (strcmp(argv[i], "--perf") == 0) {
+            reportTimings = 1;
+            if (!reportPerf && openPerfCounters() == 0) {
+                reportPerf = 1;
+            }
+        } else if (strcmp(argv[i], "--binary-output") == 0) {
+            options->binaryOutput = 1;
+        } else if (strcmp(argv[i], "--hilbert") == 0) {
+            options->hilbertOrder = 1;
+        } else if (strcmp(argv[i], "--optimize") == 0) {
+            options->optimize = 1;
+        } else if (strncmp(argv[i], "--time-limit=", 13) == 0) {
+            char* end;
+            options->timeLimit = strtod(argv[i] + 13, &end);
+            if (end == argv[i] + 13 || *end != '\0' || options->timeLimit < 0.0) {
+                fprintf(stderr, "Invalid time limit: %s\n", argv[i]);
+                return -1;
+            }
+        } else if (strncmp(argv[i], "--starts=", 9) == 0) {
+            char* end;
+            long starts = strtol(argv[i] + 9, &end, 10);
+            if (end == argv[i] + 9 || *end != '\0' || starts < 1 || starts > MAX_COORDS) {
+                fprintf(stderr, "Invalid start count: %s\n", argv[i]);
+                return -1;
+            }
+            options->numStarts = (int)starts;
+        } else if (strncmp(argv[i], "--start-time-limit=", 19) == 0) {
+            char* end;
+            options->startTimeLimit = strtod(argv[i] + 19, &end);
+            if (end == argv[i] + 19 || *end != '\0' || options->startTimeLimit < 0.0) {
+                fprintf(stderr, "Invalid start time limit: %s\n", argv[i]);
+                return -1;
+            }
+        } else if (strncmp(argv[i], "--insert-batch=", 15) == 0) {
+            char* end;
+            long batch = strtol(argv[i] + 15, &end, 10);
+            if (end == argv[i] + 15 || *end != '\0' || batch < 1 || batch > MAX_INSERT_BATCH) {
+                fprintf(stderr, "Invalid insertion batch: %s\n", argv[i]);
+                return -1;
+            }
+            options->insertBatch = (int)batch;
+        } else if (strncmp(argv[i], "--insert-tolerance=", 19) == 0) {
+            char* end;
+            options->insertTolerance = strtod(argv[i] + 19, &end);
+            if (end == argv[i] + 19 || *end != '\0' || options->insertTolerance < 0.0) {
+                fprintf(stderr, "Invalid insertion tolerance: %s\n", argv[i]);
+                return -1;
+            }
+        } else if (strncmp(argv[i], "--partition=", 12) == 0) {
+            char* end;
+            long size = strtol(argv[i] + 12, &end, 10);
+            if (end == argv[i] + 12 || *end != '\0' || size < 0 || size > MAX_COORDS) {
+                fprintf(stderr, "Invalid partition size: %s\n", argv[i]);
+                return -1;
+            }
+            options->partitionSize = (int)size;
+        } else if (strncmp(argv[i], "--max-moves=", 12) == 0) {
+            char* end;
+            options->maxMoves = strtol(argv[i] + 12, &end, 10);
+            if (end == argv[i] + 12 || *end != '\0' || options->maxMoves < 0) {
+                fprintf(stderr, "Invalid move limit: %s\n", argv[i]);
+                return -1;
+            }
+        } else {
+            fprintf(stderr, "Unknown option: %s\n", argv[i]);
+            return -1;
+        }
+    }
+
+    return checkOptions(options);
+}
+
+int checkOptions(const TspOptions* options) {
+    if (options->distanceMode != DISTANCES_MATRIX && options->distanceMode != DISTANCES_PACKED &&
+        options->distanceMode != DISTANCES_NONE) {
+        fprintf(stderr, "Unknown distance mode %d\n", (int)options->distanceMode);
+        return -1;
+    }
+    if (options->metric != METRIC_EUCLIDEAN && options->metric != METRIC_SQUARED &&
+        options->metric != METRIC_MANHATTAN && options->metric != METRIC_HAVERSINE) {
+        fprintf(stderr, "Unknown metric %d\n", (int)options->metric);
+        return -1;
+    }
+    if (options->useFloat && options->distanceMode == DISTANCES_MATRIX) {
+        fprintf(stderr, "--float needs --distances=packed or --distances=none\n");
+        return -1;
+    }
+    if (options->useFloat && options->distanceMode == DISTANCES_NONE && options->metric != METRIC_EUCLIDEAN) {
+        fprintf(stderr, "--float with --distances=none needs --metric=euclidean\n");
+        return -1;
+    }
+    if (options->partitionSize > 0 && options->numStarts > 1) {
+        fprintf(stderr, "--partition builds one tour per part, it cannot be combined with --starts\n");
+        return -1;
+    }
+    if (options->numNeighbors < 0 || options->numStarts < 1 || options->insertBatch < 1 ||
+        options->insertBatch > MAX_INSERT_BATCH || options->partitionSize < 0 || options->maxMoves < 0 ||
+        !(options->timeLimit >= 0.0) || !(options->startTimeLimit >= 0.0) || !(options->insertTolerance >= 0.0)) {
+        fprintf(stderr, "Option values out of range\n");
+        return -1;
+    }
+    return 0;
+}
+
+void printOptionsUsage(void) {
+    printf("Options:\n");
+    printf("  --distances=matrix  precompute the n x n distance matrix (default)\n");
+    printf("  --distances=packed  precompute only the upper triangle, half the memory\n");
+    printf("  --distances=none    compute distances on the fly, O(n) memory\n");
+    printf("  --metric=euclidean  straight-line distances (default)\n");
+    printf("  --metric=squared    squared straight-line distances\n");
+    printf("  --metric=manhattan  sums of the x and y differences\n");
+    printf("  --metric=haversine  great-circle kilometres, the input holds latitude,longitude\n");
+    printf("                      pairs in degrees\n");
+    printf("  --float             single precision packed or on-the-fly distances, on the fly\n");
+    printf("                      only with --metric=euclidean\n");
+    printf("  --neighbors=K       serial solvers only consider tour edges at the K nearest\n");
+    printf("                      neighbours of a vertex, 0 scans every edge (default)\n");
+    printf("  --timings           print the wall time of each phase on stderr\n");
+    printf("  --stats             also print the operation counts and per-thread busy and idle\n");
+    printf("                      time of each phase\n");
+    printf("  --perf              also print the hardware cycles, instructions and cache misses\n");
+    printf("                      of each phase, on Linux when perf events are permitted\n");
+    printf("  --binary-output     write the tour in the binary format instead of text\n");
+    printf("  --hilbert           renumber the vertices along a Hilbert curve for memory locality,\n");
+    printf("                      tours are still written with the input ids\n");
+    printf("  --starts=N          serial solvers build tours from N start vertices, in parallel\n");
+    printf("                      when built with -fopenmp, and keep the shortest (default 1)\n");
+    printf("  --start-time-limit=S  begin no more starts after S seconds and drop unfinished\n");
+    printf("                      ones, the tour from vertex 0 is always finished\n");
+    printf("  --insert-batch=B    the OpenMP cheapest insertion inserts up to B vertices on\n");
+    printf("                      distinct edges per round, 1 keeps it exact (default)\n");
+    printf("  --insert-tolerance=T  a batch takes vertices costing at most 1 + T times the\n");
+    printf("                      round's cheapest insertion (default 0.25)\n");
+    printf("  --partition=P       serial solvers split more than P vertices into parts of at most P\n");
+    printf("                      by recursive bisection, solve them in parallel when built with\n");
+    printf("                      -fopenmp and stitch their tours, 0 solves them whole (default);\n");
+    printf("                      not together with --starts\n");
+    printf("  --optimize          improve the tour with 2-opt and Or-opt after construction\n");
+    printf("  --time-limit=S      stop the improvement after S seconds, 0 for no limit (default)\n");
+    printf("  --max-moves=N       stop the improvement after N moves, 0 for no limit (default)\n");
+}
+
+// Powers of ten that are exact in double precision
+static const double exactPowersOfTen[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static inline int isBlank(char c) {
+    return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+static inline int isDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+// Parse the token starting at *cursor with strtod, as fscanf("%lf") would. The token
+// runs to the next blank or comma. Returns 1 and moves the cursor past the number,
+// or 0 if there is none.
+static int parseWithStrtod(const char** cursor, const char* end, double* value) {
+    const char* p = *cursor;
+    while (p < end && !isBlank(*p) && *p != ',') {
+        p++;
+    }
+    char text[128];
+    size_t length = p - *cursor;
+    char* copy = length < sizeof(text) ? text : malloc(length + 1);
+    if (!copy) {
+        return 0;
+    }
+    memcpy(copy, *cursor, length);
+    copy[length] = '\0';
+    char* stop;
+    *value = strtod(copy, &stop);
+    size_t used = stop - copy;
+    if (copy != text) {
+        free(copy);
+    }
+    if (used == 0) {
+        return 0;
+    }
+    *cursor += used;
+    return 1;
+}
+
+// Parse a number starting at *cursor. Plain decimals such as -12.5e3 are parsed here
+// independent of the locale; hexadecimal, inf and nan go to strtod as with fscanf.
+// Returns 1 and moves the cursor past it, or 0 if there is none.
+static int parseDouble(const char** cursor, const char* end, double* value) {
+    const char* p = *cursor;
+    int negative = 0;
+    if (p < end && (*p == '+' || *p == '-')) {
+        negative = *p == '-';
+        p++;
+    }
+    const char* digits = p;
+    if (p < end && !isDigit(*p) && *p != '.') {
+        return parseWithStrtod(cursor, end, value);
+    }
+    if (end - p >= 2 && p[0] == '0' && (p[1] == 'x' || p[1] == 'X')) {
+        return parseWithStrtod(cursor, end, value);
+    }
+
+    // Up to 19 significant digits fit the mantissa, a dropped non-zero digit makes it inexact
+    uint64_t mantissa = 0;
+    int significant = 0;
+    int exponent = 0;
+    int anyDigit = 0;
+    int inexact = 0;
+    for (; p < end && isDigit(*p); p++) {
+        anyDigit = 1;
+        if (significant < 19) {
+            mantissa = mantissa * 10 + (*p - '0');
+            significant += mantissa != 0;
+        } else {
+            exponent++;
+            inexact |= *p != '0';
+        }
+    }
+    if (p < end && *p == '.') {
+        for (p++; p < end && isDigit(*p); p++) {
+            anyDigit = 1;
+            if (significant < 19) {
+                mantissa = mantissa * 10 + (*p - '0');
+                significant += mantissa != 0;
+                exponent--;
+            } else {
+                inexact |= *p != '0';
+            }
+        }
+    }
+    if (!anyDigit) {
+        return 0;
+    }
+
+    // Like glibc's fscanf, an exponent marker and sign are consumed even without digits
+    const char* numberEnd = p;
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        int exponentSign = 1;
+        p++;
+        if (p < end && (*p == '+' || *p == '-')) {
+            exponentSign = *p == '-' ? -1 : 1;
+            p++;
+        }
+        int written = 0;
+        for (; p < end && isDigit(*p); p++) {
+            numberEnd = p + 1;
+            if (written < 100000) {
+                written = written * 10 + (*p - '0');
+            }
+        }
+        exponent += exponentSign * written;
+    }
+
+    // One correctly rounded operation on exact operands gives the correctly rounded
+    // result; anything else goes to strtod, which the solvers only use in the C locale
+    double result;
+    if (!inexact && mantissa <= ((uint64_t)1 << 53) && exponent >= -22 && exponent <= 22) {
+        result = exponent < 0 ? (double)mantissa / exactPowersOfTen[-exponent]
+                              : (double)mantissa * exactPowersOfTen[exponent];
+    } else {
+        char text[128];
+        size_t length = numberEnd - digits;
+        char* copy = length < sizeof(text) ? text : malloc(length + 1);
+        if (!copy) {
+            return 0;
+        }
+        memcpy(copy, digits, length);
+        copy[length] = '\0';
+        result = strtod(copy, NULL);
+        if (copy != text) {
+            free(copy);
+        }
+    }
+
+    *value = negative ? -result : result;
+    *cursor = p;
+    return 1;
+}
+
+// Slice of the input parsed by one thread into its own slots of the coordinate arrays
+typedef struct {
+    const char* begin;
+    const char* end;
+    size_t first; // first slot, far enough from the next chunk's for every record to fit
+    size_t count; // records parsed
+    int stopped; // hit text that is not an "x,y" record
+} CoordinateChunk;
+
+// Parse the "x,y" records of a chunk as fscanf("%lf,%lf") would: blanks may come
+// before either number but not before the comma, and the first malformed record ends the input
+static void parseChunk(CoordinateChunk* chunk, double* xs, double* ys) {
+    const char* p = chunk->begin;
+    const char* end = chunk->end;
+    size_t slot = chunk->first;
+    while (1) {
+        while (p < end && isBlank(*p)) {
+            p++;
+        }
+        if (p == end) {
+            break;
+        }
+        double x, y;
+        if (!parseDouble(&p, end, &x) || p == end || *p != ',') {
+            chunk->stopped = 1;
+            break;
+        }
+        p++;
+        while (p < end && isBlank(*p)) {
+            p++;
+        }
+        if (!parseDouble(&p, end, &y)) {
+            chunk->stopped = 1;
+            break;
+        }
+        xs[slot] = x;
+        ys[slot] = y;
+        slot++;
+    }
+    chunk->count = slot - chunk->first;
+}
+
+// Move a chunk boundary forward to the start of a line that begins a new record,
+// that is one not continuing after a trailing comma
+static const char* nextRecordStart(const char* p, const char* begin, const char* end) {
+    while (p < end) {
+        const char* newline = memchr(p, '\n', end - p);
+        if (!newline) {
+            return end;
+        }
+        const char* last = newline;
+        while (last > begin && isBlank(last[-1])) {
+            last--;
+        }
+        if (last == begin || last[-1] != ',') {
+            return newline + 1;
+        }
+        p = newline + 1;
+    }
+    return end;
+}
+
+void* mapInputFile(const char* filename, size_t* size, int* mapped) {
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        perror("Error opening file");
+        return NULL;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+        // Private and writable, so data used in place can still be changed by its owner
+        void* data = mmap(NULL, info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            madvise(data, info.st_size, MADV_SEQUENTIAL);
+            close(fd);
+            *size = info.st_size;
+            *mapped = 1;
+            return data;
+        }
+    }
+
+    // Pipes and other unmappable files are read in full
+    size_t capacity = 1 << 16;
+    size_t length = 0;
+    char* data = malloc(capacity);
+    ssize_t got = 0;
+    while (data && (got = read(fd, data + length, capacity - length)) > 0) {
+        length += got;
+        if (length == capacity) {
+            capacity *= 2;
+            char* grown = realloc(data, capacity);
+            if (!grown) {
+                free(data);
+            }
+            data = grown;
+        }
+    }
+    close(fd);
+    if (!data || got < 0) {
+        perror("Error reading file");
+        free(data);
+        return NULL;
+    }
+    *size = length;
+    *mapped = 0;
+    return data;
+}
+
+void releaseInputFile(void* data, size_t size, int mapped) {
+    if (mapped) {
+        munmap(data, size);
+    } else {
+        free(data);
+    }
+}
+
+// A buffer of at least bytes, buffer itself when it is large enough. Its contents
+// are not kept. NULL on failure, which frees buffer and zeroes *capacity.
+static void* reserveBuffer(void* buffer, size_t* capacity, size_t bytes) {
+    if (buffer && *capacity >= bytes) {
+        return buffer;
+    }
+    free(buffer);
+    buffer = malloc(bytes);
+    *capacity = buffer ? bytes : 0;
+    return buffer;
+}
+
+// Room for slots coordinates in x and y, 0 on success and -1 on failure
+static int reserveCoordinates(TspProblem* problem, size_t slots) {
+    problem->x = reserveBuffer(problem->x, &problem->xBytes, slots * sizeof(double));
+    problem->y = reserveBuffer(problem->y, &problem->yBytes, slots * sizeof(double));
+    if (!problem->x || !problem->y) {
+        perror("Memory allocation for coordinates failed");
+        return -1;
+    }
+    return 0;
+}
+
+static int littleEndianHost(void) {
+    const uint16_t one = 1;
+    return *(const uint8_t*)&one == 1;
+}
+
+#define FNV_OFFSET 14695981039346656037ull
+#define FNV_PRIME 1099511628211ull
+
+// Checksum over a payload written in several parts, as if they were one buffer
+typedef struct {
+    uint64_t hash;
+    uint64_t pending; // bytes of an unfinished word, lowest first
+    int pendingBytes;
+} Checksum;
+
+static void checksumUpdate(Checksum* checksum, const void* data, size_t size) {
+    const unsigned char* bytes = data;
+    while (size > 0 && checksum->pendingBytes > 0) {
+        checksum->pending |= (uint64_t)*bytes++ << (8 * checksum->pendingBytes);
+        size--;
+        if (++checksum->pendingBytes == 8) {
+            checksum->hash = (checksum->hash ^ checksum->pending) * FNV_PRIME;
+            checksum->pending = 0;
+            checksum->pendingBytes = 0;
+        }
+    }
+    for (; size >= 8; size -= 8, bytes += 8) {
+        uint64_t word;
+        memcpy(&word, bytes, sizeof(word));
+        checksum->hash = (checksum->hash ^ word) * FNV_PRIME;
+    }
+    for (; size > 0; size--) {
+        checksum->pending |= (uint64_t)*bytes++ << (8 * checksum->pendingBytes++);
+    }
+}
+
+// The last word is padded with zero bytes
+static uint64_t checksumFinish(const Checksum* checksum) {
+    if (checksum->pendingBytes == 0) {
+        return checksum->hash;
+    }
+    return (checksum->hash ^ checksum->pending) * FNV_PRIME;
+}
+
+uint64_t binaryChecksum(const void* data, size_t size) {
+    Checksum checksum = { FNV_OFFSET, 0, 0 };
+    checksumUpdate(&checksum, data, size);
+    return checksumFinish(&checksum);
+}
+
+static size_t elementSize(uint16_t elementType) {
+    switch (elementType) {
+        case ELEMENT_F32:
+        case ELEMENT_U32:
+            return 4;
+        case ELEMENT_F64:
+            return 8;
+        default:
+            return 0;
+    }
+}
+
+int writeBinaryFile(const char* filename, uint32_t magic, BinaryElementType elementType, uint64_t count,
+                    const void* const parts[], const size_t partSizes[], int numParts) {
+    if (!littleEndianHost()) {
+        fprintf(stderr, "Error: binary files can only be written on little-endian hosts\n");
+        return -1;
+    }
+
+    Checksum checksum = { FNV_OFFSET, 0, 0 };
+    for (int i = 0; i < numParts; i++) {
+        checksumUpdate(&checksum, parts[i], partSizes[i]);
+    }
+    BinaryHeader header = { magic, BINARY_FORMAT_VERSION, elementType, count, checksumFinish(&checksum), 0 };
+
+    FILE* file = fopen(filename, "wb");
+    if (!file) {
+        perror("Error opening output file");
+        return -1;
+    }
+    int status = fwrite(&header, sizeof(header), 1, file) == 1 ? 0 : -1;
+    for (int i = 0; status == 0 && i < numParts; i++) {
+        if (partSizes[i] > 0 && fwrite(parts[i], partSizes[i], 1, file) != 1) {
+            status = -1;
+        }
+    }
+    if (fclose(file) != 0) {
+        status = -1;
+    }
+    if (status != 0) {
+        perror("Error writing output file");
+    }
+    return status;
+}
+
+int checkBinaryHeader(const void* data, size_t size, const char* filename, uint32_t magic, BinaryHeader* header) {
+    if (!littleEndianHost()) {
+        fprintf(stderr, "Error: binary files can only be read on little-endian hosts\n");
+        return -1;
+    }
+    if (size < sizeof(BinaryHeader)) {
+        fprintf(stderr, "Error: %s is too short for a binary header\n", filename);
+        return -1;
+    }
+    memcpy(header, data, sizeof(BinaryHeader));
+    if (header->magic != magic) {
+        fprintf(stderr, "Error: %s is not a binary %s file\n", filename, magic == BINARY_TOUR_MAGIC ? "tour" : "coordinate");
+        return -1;
+    }
+    if (header->version != BINARY_FORMAT_VERSION) {
+        fprintf(stderr, "Error: %s has unsupported format version %u\n", filename, (unsigned)header->version);
+        return -1;
+    }
+
+    // Coordinates hold an x and a y per point, tours one id per vertex
+    size_t width = elementSize(header->elementType) * (magic == BINARY_COORDS_MAGIC ? 2 : 1);
+    size_t payloadSize = size - sizeof(BinaryHeader);
+    if (width == 0 || header->count > payloadSize / width || header->count * width != payloadSize) {
+        fprintf(stderr, "Error: %s does not match the size its header declares\n", filename);
+        return -1;
+    }
+    if (binaryChecksum((const char*)data + sizeof(BinaryHeader), payloadSize) != header->checksum) {
+        fprintf(stderr, "Error: checksum mismatch in %s\n", filename);
+        return -1;
+    }
+    return 0;
+}
+
+// Coordinates of a binary file into problem. f64 coordinates in a mapped file are used
+// in place when inPlace is set and the problem keeps the mapping, anything else is
+// copied into the problem's buffers. The data is released unless the problem keeps it.
+static int loadBinaryCoordinates(TspProblem* problem, char* data, size_t size, int mapped, const char* filename, int inPlace) {
+    BinaryHeader header;
+    if (checkBinaryHeader(data, size, filename, BINARY_COORDS_MAGIC, &header) != 0) {
+        releaseInputFile(data, size, mapped);
+        return -1;
+    }
+    if (header.elementType != ELEMENT_F32 && header.elementType != ELEMENT_F64) {
+        fprintf(stderr, "Error: %s does not hold f32 or f64 coordinates\n", filename);
+        releaseInputFile(data, size, mapped);
+        return -1;
+    }
+    if (header.count == 0 || header.count > MAX_COORDS) {
+        if (header.count == 0) {
+            fprintf(stderr, "Error: %s contains no coordinates\n", filename);
+        } else {
+            fprintf(stderr, "Error: %s has more than %d coordinates\n", filename, MAX_COORDS);
+        }
+        releaseInputFile(data, size, mapped);
+        return -1;
+    }
+
+    int n = (int)header.count;
+    const char* payload = data + sizeof(BinaryHeader);
+    if (inPlace && header.elementType == ELEMENT_F64 && mapped) {
+        problem->numOfCoords = n;
+        problem->x = (double*)payload;
+        problem->y = problem->x + n;
+        problem->mapping = data;
+        problem->mappingSize = size;
+        return 0;
+    }
+
+    if (reserveCoordinates(problem, n) != 0) {
+        releaseInputFile(data, size, mapped);
+        return -1;
+    }
+    double* xs = problem->x;
+    double* ys = problem->y;
+    if (header.elementType == ELEMENT_F64) {
+        memcpy(xs, payload, n * sizeof(double));
+        memcpy(ys, payload + n * sizeof(double), n * sizeof(double));
+    } else {
+        for (int i = 0; i < n; i++) {
+            float x, y;
+            memcpy(&x, payload + i * sizeof(float), sizeof(float));
+            memcpy(&y, payload + (n + i) * sizeof(float), sizeof(float));
+            xs[i] = x;
+            ys[i] = y;
+        }
+    }
+    releaseInputFile(data, size, mapped);
+    problem->numOfCoords = n;
+    return 0;
+}
+
+int writeTextCoordinates(const TspProblem* problem, const char* filename) {
+    FILE* file = fopen(filename, "w");
+    if (!file) {
+        perror("Error opening output file");
+        return -1;
+    }
+    // 17 significant digits read back to the same doubles
+    for (int i = 0; i < problem->numOfCoords; i++) {
+        fprintf(file, "%.17g,%.17g\n", problem->x[i], problem->y[i]);
+    }
+    if (fclose(file) != 0) {
+        perror("Error writing output file");
+        return -1;
+    }
+    return 0;
+}
+
+int writeBinaryCoordinates(const TspProblem* problem, const char* filename, int useFloat) {
+    int n = problem->numOfCoords;
+    if (!useFloat) {
+        const void* parts[2] = { problem->x, problem->y };
+        size_t partSizes[2] = { n * sizeof(double), n * sizeof(double) };
+        return writeBinaryFile(filename, BINARY_COORDS_MAGIC, ELEMENT_F64, n, parts, partSizes, 2);
+    }
+
+    float* xs = malloc(n * sizeof(float));
+    float* ys = malloc(n * sizeof(float));
+    if (!xs || !ys) {
+        perror("Memory allocation for coordinates failed");
+        free(xs);
+        free(ys);
+        return -1;
+    }
+    for (int i = 0; i < n; i++) {
+        xs[i] = (float)problem->x[i];
+        ys[i] = (float)problem->y[i];
+    }
+    const void* parts[2] = { xs, ys };
+    size_t partSizes[2] = { n * sizeof(float), n * sizeof(float) };
+    int status = writeBinaryFile(filename, BINARY_COORDS_MAGIC, ELEMENT_F32, n, parts, partSizes, 2);
+    free(xs);
+    free(ys);
+    return status;
+}
+
+// Parse a file of "x,y" lines into the problem's buffers and release the data. The
+// file is parsed in one pass; with OpenMP large files are cut into chunks at line
+// boundaries that threads parse straight into the coordinate arrays.
+static int loadTextCoordinates(TspProblem* problem, char* data, size_t size, int mapped, const char* filename) {
+    const char* begin = data;
+    const char* end = data + size;
+
+    int numChunks = 1;
+#ifdef _OPENMP
+    if (size >= PARALLEL_PARSE_BYTES) {
+        numChunks = omp_get_max_threads();
+    }
+#endif
+
+    // Every record but the last takes at least 4 bytes, "x,y" and a separator, so a
+    // chunk of b bytes holds at most b / 4 + 1 records. Slots from offset / 4 + chunk
+    // index leave each chunk that much room.
+    CoordinateChunk single;
+    CoordinateChunk* chunks = numChunks == 1 ? &single : malloc(numChunks * sizeof(CoordinateChunk));
+    if (!chunks) {
+        perror("Memory allocation for coordinates failed");
+        releaseInputFile(data, size, mapped);
+        return -1;
+    }
+    memset(chunks, 0, numChunks * sizeof(CoordinateChunk));
+    if (reserveCoordinates(problem, size / 4 + numChunks + 1) != 0) {
+        if (chunks != &single) {
+            free(chunks);
+        }
+        releaseInputFile(data, size, mapped);
+        return -1;
+    }
+    double* xs = problem->x;
+    double* ys = problem->y;
+
+    const char* previous = begin;
+    for (int c = 0; c < numChunks; c++) {
+        chunks[c].begin = previous;
+        chunks[c].end = c == numChunks - 1 ? end : nextRecordStart(begin + size / numChunks * (c + 1), begin, end);
+        if (chunks[c].end < chunks[c].begin) {
+            chunks[c].end = chunks[c].begin;
+        }
+        chunks[c].first = (chunks[c].begin - begin) / 4 + c;
+        previous = chunks[c].end;
+    }
+
+    PARALLEL_CHUNK_LOOP
+    for (int c = 0; c < numChunks; c++) {
+        parseChunk(&chunks[c], xs, ys);
+    }
+
+    // Close the gaps between the chunks, up to the first malformed record
+    size_t numOfCoords = 0;
+    for (int c = 0; c < numChunks; c++) {
+        if (chunks[c].first != numOfCoords) {
+            memmove(xs + numOfCoords, xs + chunks[c].first, chunks[c].count * sizeof(double));
+            memmove(ys + numOfCoords, ys + chunks[c].first, chunks[c].count * sizeof(double));
+        }
+        numOfCoords += chunks[c].count;
+        if (chunks[c].stopped) {
+            break;
+        }
+    }
+    if (chunks != &single) {
+        free(chunks);
+    }
+    releaseInputFile(data, size, mapped);
+
+    if (numOfCoords == 0 || numOfCoords > MAX_COORDS) {
+        if (numOfCoords == 0) {
+            fprintf(stderr, "Error: %s contains no coordinates\n", filename);
+        } else {
+            fprintf(stderr, "Error: %s has more than %d coordinates\n", filename, MAX_COORDS);
+        }
+        return -1;
+    }
+    problem->numOfCoords = (int)numOfCoords;
+    return 0;
+}
+
+// Map the file and load it as binary or text coordinates
+static int loadInput(TspProblem* problem, const char* filename, int inPlace) {
+    size_t size = 0;
+    int mapped = 0;
+    char* data = mapInputFile(filename, &size, &mapped);
+    if (!data) {
+        return -1;
+    }
+    uint32_t magic;
+    int status;
+    if (size >= sizeof(BinaryHeader) && (memcpy(&magic, data, sizeof(magic)), magic == BINARY_COORDS_MAGIC)) {
+        status = loadBinaryCoordinates(problem, data, size, mapped, filename, inPlace);
+    } else {
+        status = loadTextCoordinates(problem, data, size, mapped, filename);
+    }
+
+    // Infinite and NaN coordinates, given or overflowed, have no distances to solve with
+    for (int i = 0; status == 0 && i < problem->numOfCoords; i++) {
+        if (!isfinite(problem->x[i]) || !isfinite(problem->y[i])) {
+            fprintf(stderr, "Error: point %d of %s is not finite\n", i, filename);
+            status = -1;
+        }
+    }
+    return status;
+}
+
+// Read a file of "x,y" lines, or a binary coordinate file, into a new problem sized to the input
+TspProblem* readCoordinates(const char* filename) {
+    TspProblem* problem = calloc(1, sizeof(TspProblem));
+    if (!problem) {
+        perror("Memory allocation for coordinates failed");
+        return NULL;
+    }
+    if (loadInput(problem, filename, 1) != 0) {
+        freeProblem(problem);
+        return NULL;
+    }
+
+    // Give back the slots the records did not need
+    size_t bytes = problem->numOfCoords * sizeof(double);
+    if (!problem->mapping && problem->xBytes > bytes) {
+        double* shrunkX = realloc(problem->x, bytes);
+        double* shrunkY = realloc(problem->y, bytes);
+        if (shrunkX) {
+            problem->x = shrunkX;
+            problem->xBytes = bytes;
+        }
+        if (shrunkY) {
+            problem->y = shrunkY;
+            problem->yBytes = bytes;
+        }
+    }
+    return problem;
+}
+
+// Drop the problem's vertices and tables but keep its buffers
+static void emptyProblem(TspProblem* problem) {
+    // A mapped input is given back, its coordinates were never the problem's own buffers
+    if (problem->mapping) {
+        munmap(problem->mapping, problem->mappingSize);
+        problem->mapping = NULL;
+        problem->x = NULL;
+        problem->y = NULL;
+        problem->xBytes = 0;
+        problem->yBytes = 0;
+    }
+    problem->numOfCoords = 0;
+    problem->reordered = 0;
+    problem->useFloat = 0;
+    problem->metric = METRIC_EUCLIDEAN;
+    problem->distanceMatrix = NULL;
+    problem->packed = NULL;
+    problem->packedf = NULL;
+    problem->numNeighbors = 0;
+}
+
+int loadCoordinates(TspProblem* problem, const char* filename) {
+    emptyProblem(problem);
+    if (loadInput(problem, filename, 0) != 0) {
+        problem->numOfCoords = 0;
+        return -1;
+    }
+    return 0;
+}
+
+int resetCoordinates(TspProblem* problem, int numOfCoords) {
+    emptyProblem(problem);
+    if (reserveCoordinates(problem, numOfCoords) != 0) {
+        return -1;
+    }
+    problem->numOfCoords = numOfCoords;
+    return 0;
+}
+
+// Length of the closed tour visiting order[0 .. numOfCoords - 1]
+#define LENGTH_BLOCK 256 // tour edges measured and summed pairwise at a time
+
+// Sum of values[0 .. count - 1] by halving, the rounding error grows with log(count)
+static double pairwiseSum(const double* values, int count) {
+    if (count <= 8) {
+        double sum = 0.0;
+        for (int k = 0; k < count; k++) {
+            sum += values[k];
+        }
+        return sum;
+    }
+    int half = count / 2;
+    return pairwiseSum(values, half) + pairwiseSum(values + half, count - half);
+}
+
+double tourLength(const TspProblem* problem, const int* order) {
+    int n = problem->numOfCoords;
+    double lengths[LENGTH_BLOCK];
+    double sum = 0.0;
+    double compensation = 0.0;
+    for (int first = 0; first < n; first += LENGTH_BLOCK) {
+        int count = n - first < LENGTH_BLOCK ? n - first : LENGTH_BLOCK;
+        // The closing edge back to order[0] ends the last block
+        int open = first + count == n ? count - 1 : count;
+        tourEdgeLengths(problem, order, first, open, lengths);
+        if (open < count) {
+            lengths[open] = coordinateDistance(problem, order[n - 1], order[0]);
+        }
+
+        // Neumaier's compensated sum of the block sums. Once the sum overflows the
+        // compensation would be inf - inf, so it stops and the length is inf.
+        double block = pairwiseSum(lengths, count);
+        double total = sum + block;
+        if (isfinite(total) && fabs(sum) >= fabs(block)) {
+            compensation += (sum - total) + block;
+        } else if (isfinite(total)) {
+            compensation += (block - total) + sum;
+        }
+        sum = total;
+    }
+    return isfinite(sum) ? sum + compensation : sum;
+}
+
+// Function to calculate the Euclidean distance between two points
+double euclideanDistance(double x1, double y1, double x2, double y2) {
+    return sqrt((x1 - x2) * (x1 - x2) + (y1 - y2) * (y1 - y2));
+}
+
+// Unit vector of the point at latitude and longitude in degrees
+static void sphereVector(double latitude, double longitude, double* x, double* y, double* z) {
+    double phi = latitude * (M_PI / 180.0);
+    double lambda = longitude * (M_PI / 180.0);
+    *x = cos(phi) * cos(lambda);
+    *y = cos(phi) * sin(lambda);
+    *z = sin(phi);
+}
+
+double pointDistance(DistanceMetric metric, double x1, double y1, double x2, double y2) {
+    switch (metric) {
+    case METRIC_SQUARED:
+        return (x1 - x2) * (x1 - x2) + (y1 - y2) * (y1 - y2);
+    case METRIC_MANHATTAN:
+        return fabs(x1 - x2) + fabs(y1 - y2);
+    case METRIC_HAVERSINE: {
+        double a[3], b[3];
+        sphereVector(x1, y1, &a[0], &a[1], &a[2]);
+        sphereVector(x2, y2, &b[0], &b[1], &b[2]);
+        double dx = a[0] - b[0], dy = a[1] - b[1], dz = a[2] - b[2];
+        double half = 0.5 * sqrt(dx * dx + dy * dy + dz * dz);
+        return 2.0 * EARTH_RADIUS_KM * arcSine(half < 1.0 ? half : 1.0);
+    }
+    default:
+        return euclideanDistance(x1, y1, x2, y2);
+    }
+}
+
+// The straight line never exceeds the Manhattan distance, while degrees of latitude
+// and longitude are not bounded by any great-circle distance
+double planarReach(const TspProblem* problem, double distance) {
+    switch (problem->metric) {
+    case METRIC_SQUARED:
+        return sqrt(distance);
+    case METRIC_HAVERSINE:
+        return DBL_MAX;
+    default:
+        return distance;
+    }
+}
+
+// Function to generate the distance matrix from the coordinates
+int calculateDistanceMatrix(TspProblem* problem) {
+    int n = problem->numOfCoords;
+
+    if ((size_t)n > SIZE_MAX / sizeof(double) / (size_t)n) {
+        fprintf(stderr, "Error: distance matrix for %d coordinates does not fit in memory\n", n);
+        return -1;
+    }
+
+    // Tables attached before are dropped, their storage is reused
+    problem->distanceMatrix = NULL;
+    problem->packed = NULL;
+    problem->packedf = NULL;
+    size_t bytes = (size_t)n * n * sizeof(double);
+    problem->table = reserveBuffer(problem->table, &problem->tableBytes, bytes);
+    double* distanceMatrix = problem->table;
+    if (!distanceMatrix) {
+        fprintf(stderr, "Error: cannot allocate %zu bytes for the distance matrix of %d coordinates\n", bytes, n);
+        return -1;
+    }
+
+    // Each tile on or above the diagonal is computed once with the batch kernels
+    // and mirrored below it. A tile row only writes columns it owns, so no locking.
+    // getDistance() still computes on the fly here, the matrix is attached after.
+    int tiles = (n + DISTANCE_TILE - 1) / DISTANCE_TILE;
+    PARALLEL_TILE_LOOP
+    for (int tileRow = 0; tileRow < tiles; tileRow++) {
+        int rowStart = tileRow * DISTANCE_TILE;
+        int rowEnd = rowStart + DISTANCE_TILE < n ? rowStart + DISTANCE_TILE : n;
+        for (int colStart = rowStart; colStart < n; colStart += DISTANCE_TILE) {
+            int colEnd = colStart + DISTANCE_TILE < n ? colStart + DISTANCE_TILE : n;
+            for (int i = rowStart; i < rowEnd; i++) {
+                int first = colStart > i ? colStart : i;
+                double* row = distanceMatrix + (size_t)i * n;
+                onTheFlyDistances(problem, i, first, colEnd - first, row + first);
+                for (int j = first; j < colEnd; j++) {
+                    distanceMatrix[(size_t)j * n + i] = row[j];
+                }
+            }
+        }
+    }
+
+    problem->distanceMatrix = distanceMatrix;
+    return 0;
+}
+
+// Function to generate the packed upper triangle of the distance matrix
+int calculatePackedDistances(TspProblem* problem, int useFloat) {
+    int n = problem->numOfCoords;
+    size_t element = useFloat ? sizeof(float) : sizeof(double);
+
+    size_t entries = (size_t)n * (n - 1) / 2;
+    if (n > 1 && entries > SIZE_MAX / element) {
+        fprintf(stderr, "Error: packed distances for %d coordinates do not fit in memory\n", n);
+        return -1;
+    }
+
+    // Tables attached before are dropped, their storage is reused. Keep one valid
+    // allocation even when there are no pairs.
+    problem->distanceMatrix = NULL;
+    problem->packed = NULL;
+    problem->packedf = NULL;
+    size_t bytes = (entries ? entries : 1) * element;
+    problem->table = reserveBuffer(problem->table, &problem->tableBytes, bytes);
+    void* packed = problem->table;
+    if (!packed) {
+        fprintf(stderr, "Error: cannot allocate %zu bytes for the packed distances of %d coordinates\n", bytes, n);
+        return -1;
+    }
+
+    // Rows are independent, the double rows are filled in place and the float
+    // rows are narrowed from one tile of doubles at a time
+    int tiles = (n + DISTANCE_TILE - 1) / DISTANCE_TILE;
+    PARALLEL_TILE_LOOP
+    for (int tileRow = 0; tileRow < tiles; tileRow++) {
+        int rowEnd = (tileRow + 1) * DISTANCE_TILE < n ? (tileRow + 1) * DISTANCE_TILE : n;
+        double distances[DISTANCE_TILE];
+        for (int i = tileRow * DISTANCE_TILE; i < rowEnd; i++) {
+            size_t row = packedRow(n, i);
+            if (!useFloat) {
+                onTheFlyDistances(problem, i, i + 1, n - i - 1, (double*)packed + row);
+                continue;
+            }
+            for (int first = i + 1; first < n; first += DISTANCE_TILE) {
+                int count = n - first < DISTANCE_TILE ? n - first : DISTANCE_TILE;
+                onTheFlyDistances(problem, i, first, count, distances);
+                for (int k = 0; k < count; k++) {
+                    ((float*)packed)[row + (first - i - 1) + k] = (float)distances[k];
+                }
+            }
+        }
+    }
+
+    if (useFloat) {
+        problem->packedf = packed;
+    } else {
+        problem->packed = packed;
+    }
+    return 0;
+}
+
+#define STACK_CANDIDATES 64 // longest neighbour list searched without allocating
+
+// Candidate kept in a bounded nearest neighbour list, ordered by distance then id
+typedef struct {
+    double distance2;
+    int vertex;
+} Candidate;
+
+// Insert (distance2, vertex) into the sorted list of at most k candidates
+static void offerCandidate(Candidate* list, int* size, int k, double distance2, int vertex) {
+    int pos = *size < k ? (*size)++ : k;
+    while (pos > 0 && (list[pos - 1].distance2 > distance2 ||
+                       (list[pos - 1].distance2 == distance2 && list[pos - 1].vertex > vertex))) {
+        if (pos < k) {
+            list[pos] = list[pos - 1];
+        }
+        pos--;
+    }
+    if (pos < k) {
+        list[pos].distance2 = distance2;
+        list[pos].vertex = vertex;
+    }
+}
+
+int buildSpatialGrid(const TspProblem* problem, SpatialGrid* grid) {
+    int n = problem->numOfCoords;
+    const double* xs = problem->x;
+    const double* ys = problem->y;
+
+    // Square cells holding about two vertices each over the bounding box
+    double minX = xs[0], maxX = xs[0], minY = ys[0], maxY = ys[0];
+    for (int i = 1; i < n; i++) {
+        minX = xs[i] < minX ? xs[i] : minX;
+        maxX = xs[i] > maxX ? xs[i] : maxX;
+        minY = ys[i] < minY ? ys[i] : minY;
+        maxY = ys[i] > maxY ? ys[i] : maxY;
+    }
+
+    // The sizes are worked out from half the extents, which cannot overflow, and the
+    // grid is capped at four cells per vertex whatever the rounding
+    double width = halfSpan(minX, maxX);
+    double height = halfSpan(minY, maxY);
+    double extent = width > height ? width : height;
+    double halfCell = extent > 0.0 ? sqrt((width * height + extent * extent / n) * 2.0 / n) : 0.5;
+    if (!isfinite(halfCell) || halfCell == 0.0) {
+        // The squares overflowed or underflowed, so size the cells relative to the extent
+        halfCell = extent * sqrt((width / extent * (height / extent) + 1.0 / n) * 2.0 / n);
+        halfCell = halfCell > 0.0 ? halfCell : extent;
+        halfCell = halfCell < 0.5 * DBL_MAX ? halfCell : 0.5 * DBL_MAX;
+    }
+    size_t maxCells = 4 * (size_t)n;
+    int cols = width / halfCell < maxCells - 1 ? (int)(width / halfCell) + 1 : (int)maxCells;
+    int rows = height / halfCell < maxCells / cols - 1 ? (int)(height / halfCell) + 1 : (int)(maxCells / cols);
+    size_t cells = (size_t)cols * rows;
+
+    grid->cellStart = reserveBuffer(grid->cellStart, &grid->cellStartBytes, (cells + 1) * sizeof(int));
+    grid->cellVertices = reserveBuffer(grid->cellVertices, &grid->cellVerticesBytes, n * sizeof(int));
+    grid->cellOf = reserveBuffer(grid->cellOf, &grid->cellOfBytes, n * sizeof(int));
+    if (!grid->cellStart || !grid->cellVertices || !grid->cellOf) {
+        perror("Memory allocation for spatial grid failed");
+        return -1;
+    }
+    grid->minX = minX;
+    grid->minY = minY;
+    grid->cellSize = 2.0 * halfCell;
+    grid->cols = cols;
+    grid->rows = rows;
+
+    // Counting sort of the vertices into their cells
+    int* cellStart = grid->cellStart;
+    int* cellOf = grid->cellOf;
+    memset(cellStart, 0, (cells + 1) * sizeof(int));
+    for (int i = 0; i < n; i++) {
+        double column = halfSpan(minX, xs[i]) / halfCell;
+        double row = halfSpan(minY, ys[i]) / halfCell;
+        size_t cx = column < cols - 1 ? (size_t)column : (size_t)cols - 1;
+        size_t cy = row < rows - 1 ? (size_t)row : (size_t)rows - 1;
+        cellOf[i] = (int)(cy * cols + cx);
+        cellStart[cellOf[i]]++;
+    }
+    for (size_t c = 1; c <= cells; c++) {
+        cellStart[c] += cellStart[c - 1];
+    }
+    for (int i = n - 1; i >= 0; i--) {
+        grid->cellVertices[--cellStart[cellOf[i]]] = i;
+    }
+    return 0;
+}
+
+void freeSpatialGrid(SpatialGrid* grid) {
+    free(grid->cellStart);
+    free(grid->cellVertices);
+    free(grid->cellOf);
+    free(grid->candidates);
+    memset(grid, 0, sizeof(SpatialGrid));
+}
+
+int fillNearestNeighbors(const TspProblem* problem, int k, int* neighbors, SpatialGrid* grid) {
+    int n = problem->numOfCoords;
+    const double* xs = problem->x;
+    const double* ys = problem->y;
+
+    if (buildSpatialGrid(problem, grid) != 0) {
+        return -1;
+    }
+    int cols = grid->cols;
+    int rows = grid->rows;
+    double cellSize = grid->cellSize;
+    const int* cellStart = grid->cellStart;
+    const int* cellVertices = grid->cellVertices;
+    const int* cellOf = grid->cellOf;
+
+    // Short lists live on the stack, longer ones in the grid's buffer, one per thread,
+    // so repeated searches allocate nothing
+    if (k > STACK_CANDIDATES) {
+        size_t bytes = (size_t)MAX_TILE_THREADS * k * sizeof(Candidate);
+        grid->candidates = reserveBuffer(grid->candidates, &grid->candidatesBytes, bytes);
+        if (!grid->candidates) {
+            perror("Memory allocation for neighbour lists failed");
+            return -1;
+        }
+    }
+    Candidate* threadLists = grid->candidates;
+
+    // Search rings of cells around each vertex until the kth nearest found so far
+    // is closer than anything a further ring could hold. Candidates are ranked by
+    // squared straight-line distance, by Manhattan distance for that metric, which is
+    // bounded the same way; haversine lists are nearest in latitude and longitude.
+    int manhattan = problem->metric == METRIC_MANHATTAN;
+    int tiles = (n + DISTANCE_TILE - 1) / DISTANCE_TILE;
+    PARALLEL_TILE_LOOP
+    for (int tile = 0; tile < tiles; tile++) {
+        Candidate stackList[STACK_CANDIDATES];
+        Candidate* list = k <= STACK_CANDIDATES ? stackList : threadLists + (size_t)TILE_THREAD * k;
+        int end = (tile + 1) * DISTANCE_TILE < n ? (tile + 1) * DISTANCE_TILE : n;
+        for (int v = tile * DISTANCE_TILE; v < end; v++) {
+            int cx = cellOf[v] % cols;
+            int cy = cellOf[v] / cols;
+            int size = 0;
+            for (int ring = 0; ring <= cols + rows; ring++) {
+                for (int y = cy - ring; y <= cy + ring; y++) {
+                    if (y < 0 || y >= rows) {
+                        continue;
+                    }
+                    // Interior rows of the ring only touch its left and right cells
+                    int step = (y == cy - ring || y == cy + ring) ? 1 : 2 * ring;
+                    for (int x = cx - ring; x <= cx + ring; x += step) {
+                        if (x < 0 || x >= cols) {
+                            continue;
+                        }
+                        size_t cell = (size_t)y * cols + x;
+                        for (int c = cellStart[cell]; c < cellStart[cell + 1]; c++) {
+                            int u = cellVertices[c];
+                            if (u != v) {
+                                double dx = xs[u] - xs[v];
+                                double dy = ys[u] - ys[v];
+                                offerCandidate(list, &size, k, manhattan ? fabs(dx) + fabs(dy) : dx * dx + dy * dy, u);
+                            }
+                        }
+                    }
+                }
+                double reach = ring * cellSize;
+                if (size == k && list[k - 1].distance2 <= (manhattan ? reach : reach * reach)) {
+                    break;
+                }
+            }
+            for (int m = 0; m < k; m++) {
+                neighbors[(size_t)v * k + m] = list[m].vertex;
+            }
+        }
+    }
+    return 0;
+}
+
+int* findNearestNeighbors(const TspProblem* problem, int k) {
+    int* neighbors = malloc((size_t)problem->numOfCoords * k * sizeof(int));
+    if (!neighbors) {
+        perror("Memory allocation for neighbour lists failed");
+        return NULL;
+    }
+    SpatialGrid grid = { 0 };
+    int status = fillNearestNeighbors(problem, k, neighbors, &grid);
+    freeSpatialGrid(&grid);
+    if (status != 0) {
+        free(neighbors);
+        return NULL;
+    }
+    return neighbors;
+}
+
+int buildNeighborLists(TspProblem* problem, int k) {
+    int n = problem->numOfCoords;
+    if (k > n - 1) {
+        k = n - 1;
+    }
+    if (k <= 0) {
+        return 0;
+    }
+
+    size_t entries = (size_t)n * k;
+    problem->numNeighbors = 0;
+    problem->neighbors = reserveBuffer(problem->neighbors, &problem->neighborBytes, entries * sizeof(int));
+    problem->reverseStart = reserveBuffer(problem->reverseStart, &problem->reverseStartBytes, (n + 1) * sizeof(int));
+    problem->reverseNeighbors = reserveBuffer(problem->reverseNeighbors, &problem->reverseNeighborBytes, entries * sizeof(int));
+    if (!problem->neighbors || !problem->reverseStart || !problem->reverseNeighbors) {
+        perror("Memory allocation for neighbour lists failed");
+        return -1;
+    }
+    int* neighbors = problem->neighbors;
+    int* reverseStart = problem->reverseStart;
+    int* reverseNeighbors = problem->reverseNeighbors;
+    if (fillNearestNeighbors(problem, k, neighbors, &problem->grid) != 0) {
+        return -1;
+    }
+    memset(reverseStart, 0, (n + 1) * sizeof(int));
+
+    // Invert the lists so each vertex knows who lists it
+    for (size_t m = 0; m < (size_t)n * k; m++) {
+        reverseStart[neighbors[m] + 1]++;
+    }
+    for (int v = 0; v < n; v++) {
+        reverseStart[v + 1] += reverseStart[v];
+    }
+    for (int v = 0; v < n; v++) {
+        for (int m = 0; m < k; m++) {
+            int u = neighbors[(size_t)v * k + m];
+            reverseNeighbors[reverseStart[u]++] = v;
+        }
+    }
+    for (int v = n; v > 0; v--) {
+        reverseStart[v] = reverseStart[v - 1];
+    }
+    reverseStart[0] = 0;
+
+    problem->numNeighbors = k;
+    return 0;
+}
+
+void freeProblem(TspProblem* problem) {
+    if (!problem) {
+        return;
+    }
+    if (problem->mapping) {
+        munmap(problem->mapping, problem->mappingSize);
+    } else {
+        free(problem->x);
+        free(problem->y);
+    }
+    free(problem->xf);
+    free(problem->yf);
+    free(problem->ux);
+    free(problem->table);
+    free(problem->neighbors);
+    free(problem->reverseStart);
+    free(problem->reverseNeighbors);
+    freeSpatialGrid(&problem->grid);
+    free(problem->originalId);
+    free(problem->reorderedId);
+    free(problem);
+}
+
+// SIMD level of the running CPU, 0 scalar, 1 AVX2, 2 AVX-512
+static int detectSimdLevel(void) {
+#ifdef TSP_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        return 2;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        return 1;
+    }
+#endif
+    return 0;
+}
+
+#define HILBERT_BITS 16 // bits per axis of the Hilbert curve the vertices are placed on
+
+// Position along the Hilbert curve over a 2^HILBERT_BITS square grid of the cell (x, y)
+static uint64_t hilbertIndex(uint32_t x, uint32_t y) {
+    const uint32_t side = 1u << HILBERT_BITS;
+    uint64_t index = 0;
+    for (uint32_t s = side / 2; s > 0; s /= 2) {
+        uint32_t rx = (x & s) != 0;
+        uint32_t ry = (y & s) != 0;
+        index += (uint64_t)s * s * ((3 * rx) ^ ry);
+        // Rotate the quadrant so the curve inside it has the standard orientation
+        if (ry == 0) {
+            if (rx == 1) {
+                x = side - 1 - x;
+                y = side - 1 - y;
+            }
+            uint32_t swap = x;
+            x = y;
+            y = swap;
+        }
+    }
+    return index;
+}
+
+// Cell of a scaled coordinate on an axis of the curve's grid, clamped to the grid,
+// 0 for NaN
+static uint32_t hilbertCell(double position) {
+    const double last = (1u << HILBERT_BITS) - 1;
+    return position > 0.0 ? (uint32_t)(position < last ? position : last) : 0;
+}
+
+static int compareKeys(const void* a, const void* b) {
+    uint64_t ka = *(const uint64_t*)a;
+    uint64_t kb = *(const uint64_t*)b;
+    return (ka > kb) - (ka < kb);
+}
+
+int reorderHilbert(TspProblem* problem) {
+    int n = problem->numOfCoords;
+    double* xs = problem->x;
+    double* ys = problem->y;
+    problem->reordered = 0;
+
+    // The curve index goes above the vertex id in one key, so sorting keys sorts by
+    // index with ties in id order. The distance table storage is free until the
+    // tables are built, so it holds the keys.
+    problem->originalId = reserveBuffer(problem->originalId, &problem->originalIdBytes, n * sizeof(int));
+    problem->reorderedId = reserveBuffer(problem->reorderedId, &problem->reorderedIdBytes, n * sizeof(int));
+    problem->table = reserveBuffer(problem->table, &problem->tableBytes, n * sizeof(uint64_t));
+    if (!problem->originalId || !problem->reorderedId || !problem->table) {
+        perror("Memory allocation for Hilbert order failed");
+        return -1;
+    }
+    problem->distanceMatrix = NULL;
+    problem->packed = NULL;
+    problem->packedf = NULL;
+    uint64_t* keys = problem->table;
+
+    double minX = xs[0], maxX = xs[0], minY = ys[0], maxY = ys[0];
+    for (int i = 1; i < n; i++) {
+        minX = xs[i] < minX ? xs[i] : minX;
+        maxX = xs[i] > maxX ? xs[i] : maxX;
+        minY = ys[i] < minY ? ys[i] : minY;
+        maxY = ys[i] > maxY ? ys[i] : maxY;
+    }
+    // Half the extents cannot overflow, and halving them leaves the cells as they were
+    double width = halfSpan(minX, maxX);
+    double height = halfSpan(minY, maxY);
+    double extent = width > height ? width : height;
+    double scale = extent > 0.0 ? ((1u << HILBERT_BITS) - 1) / extent : 0.0;
+    for (int i = 0; i < n; i++) {
+        uint32_t cx = hilbertCell(halfSpan(minX, xs[i]) * scale);
+        uint32_t cy = hilbertCell(halfSpan(minY, ys[i]) * scale);
+        keys[i] = hilbertIndex(cx, cy) << 32 | (uint32_t)i;
+    }
+    qsort(keys, n, sizeof(uint64_t), compareKeys);
+
+    // Rotate the curve order to start at vertex 0, which the solvers start their tours from
+    int zeroAt = 0;
+    while ((int)(keys[zeroAt] & 0xffffffffu) != 0) {
+        zeroAt++;
+    }
+    for (int i = 0; i < n; i++) {
+        int v = (int)(keys[(zeroAt + i) % n] & 0xffffffffu);
+        problem->originalId[i] = v;
+        problem->reorderedId[v] = i;
+    }
+
+    // Move the coordinates along the cycles of the permutation, vertex i takes the
+    // coordinates of input vertex originalId[i]. Finished slots are marked in the keys.
+    for (int i = 0; i < n; i++) {
+        keys[i] = 0;
+    }
+    for (int start = 0; start < n; start++) {
+        if (keys[start]) {
+            continue;
+        }
+        double x = xs[start];
+        double y = ys[start];
+        int i = start;
+        while (problem->originalId[i] != start) {
+            int from = problem->originalId[i];
+            xs[i] = xs[from];
+            ys[i] = ys[from];
+            keys[i] = 1;
+            i = from;
+        }
+        xs[i] = x;
+        ys[i] = y;
+        keys[i] = 1;
+    }
+    problem->reordered = 1;
+    return 0;
+}
+
+void toOriginalIds(const TspProblem* problem, int* order, int count) {
+    for (int i = 0; problem->reordered && i < count; i++) {
+        order[i] = problem->originalId[order[i]];
+    }
+}
+
+void toReorderedIds(const TspProblem* problem, int* order, int count) {
+    for (int i = 0; problem->reordered && i < count; i++) {
+        order[i] = problem->reorderedId[order[i]];
+    }
+}
+
+int prepareDistances(TspProblem* problem, const TspOptions* options) {
+    int n = problem->numOfCoords;
+    problem->simdLevel = detectSimdLevel();
+    problem->options = *options;
+    problem->metric = options->metric;
+    problem->useFloat = 0;
+    problem->numNeighbors = 0;
+
+    // Renumber first, so every table is built in the new order
+    if (options->hilbertOrder && !problem->reordered && reorderHilbert(problem) != 0) {
+        return -1;
+    }
+
+    // The partitions of a split problem have their own tables, the whole one only
+    // measures the stitched tour and improves it with --optimize
+    DistanceMode mode = options->distanceMode;
+    if (options->partitionSize > 0 && n > options->partitionSize) {
+        mode = DISTANCES_NONE;
+    }
+
+    // Great-circle distances are taken between unit vectors, found once per vertex
+    if (options->metric == METRIC_HAVERSINE) {
+        problem->ux = reserveBuffer(problem->ux, &problem->sphereBytes, 3 * (size_t)n * sizeof(double));
+        if (!problem->ux) {
+            perror("Memory allocation for unit vectors failed");
+            return -1;
+        }
+        problem->uy = problem->ux + n;
+        problem->uz = problem->ux + 2 * (size_t)n;
+        for (int i = 0; i < n; i++) {
+            if (!(fabs(problem->x[i]) <= 90.0)) {
+                fprintf(stderr, "Error: point %d has latitude %g, not -90 .. 90\n", originalVertex(problem, i), problem->x[i]);
+                return -1;
+            }
+            sphereVector(problem->x[i], problem->y[i], &problem->ux[i], &problem->uy[i], &problem->uz[i]);
+        }
+    }
+
+    int status = 0;
+    if (mode == DISTANCES_PACKED) {
+        status = calculatePackedDistances(problem, options->useFloat);
+    } else {
+        // Single precision coordinates only serve the straight-line metric, a
+        // partitioned problem measured with another one stays in double
+        if (options->useFloat && options->metric == METRIC_EUCLIDEAN) {
+            problem->xf = reserveBuffer(problem->xf, &problem->xfBytes, n * sizeof(float));
+            problem->yf = reserveBuffer(problem->yf, &problem->yfBytes, n * sizeof(float));
+            if (!problem->xf || !problem->yf) {
+                perror("Memory allocation for single precision coordinates failed");
+                return -1;
+            }
+            for (int i = 0; i < n; i++) {
+                problem->xf[i] = (float)problem->x[i];
+                problem->yf[i] = (float)problem->y[i];
+            }
+            problem->useFloat = 1;
+        }
+
+        if (mode == DISTANCES_MATRIX) {
+            status = calculateDistanceMatrix(problem);
+        }
+    }
+
+    if (status == 0 && options->numNeighbors > 0) {
+        status = buildNeighborLists(problem, options->numNeighbors);
+    }
+    return status;
+}
+
+// Batch kernels. Each scores a run of consecutive candidate vertices against one
+// point or edge, reading the SoA coordinates with unit stride. The arithmetic is
+// the same as getDistance(), so results match the scalar path exactly.
+
+static void distancesScalar(const TspProblem* problem, int v, int first, int count, double* out) {
+    for (int k = 0; k < count; k++) {
+        out[k] = getDistance(problem, v, first + k);
+    }
+}
+
+static void insertionCostsScalar(const TspProblem* problem, int a, int b, int first, int count, double* out) {
+    double ab = getDistance(problem, a, b);
+    for (int k = 0; k < count; k++) {
+        out[k] = getDistance(problem, a, first + k) + getDistance(problem, first + k, b) - ab;
+    }
+}
+
+#ifdef TSP_X86_KERNELS
+
+__attribute__((target("avx2")))
+static inline __m256d distance4(__m256d px, __m256d py, const double* xs, const double* ys) {
+    __m256d dx = _mm256_sub_pd(px, _mm256_loadu_pd(xs));
+    __m256d dy = _mm256_sub_pd(py, _mm256_loadu_pd(ys));
+    return _mm256_sqrt_pd(_mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy)));
+}
+
+__attribute__((target("avx2")))
+static inline __m256 distance8f(__m256 px, __m256 py, const float* xs, const float* ys) {
+    __m256 dx = _mm256_sub_ps(px, _mm256_loadu_ps(xs));
+    __m256 dy = _mm256_sub_ps(py, _mm256_loadu_ps(ys));
+    return _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)));
+}
+
+__attribute__((target("avx512f")))
+static inline __m512d distance8(__m512d px, __m512d py, const double* xs, const double* ys) {
+    __m512d dx = _mm512_sub_pd(px, _mm512_loadu_pd(xs));
+    __m512d dy = _mm512_sub_pd(py, _mm512_loadu_pd(ys));
+    return _mm512_sqrt_pd(_mm512_add_pd(_mm512_mul_pd(dx, dx), _mm512_mul_pd(dy, dy)));
+}
+
+__attribute__((target("avx512f")))
+static inline __m512 distance16f(__m512 px, __m512 py, const float* xs, const float* ys) {
+    __m512 dx = _mm512_sub_ps(px, _mm512_loadu_ps(xs));
+    __m512 dy = _mm512_sub_ps(py, _mm512_loadu_ps(ys));
+    return _mm512_sqrt_ps(_mm512_add_ps(_mm512_mul_ps(dx, dx), _mm512_mul_ps(dy, dy)));
+}
+
+// Widen the low and high halves of float distances to double
+__attribute__((target("avx512f")))
+static inline __m512d lowHalf16(__m512 v) {
+    return _mm512_cvtps_pd(_mm512_castps512_ps256(v));
+}
+
+__attribute__((target("avx512f")))
+static inline __m512d highHalf16(__m512 v) {
+    return _mm512_cvtps_pd(_mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(v), 1)));
+}
+
+// Lengths of the tour edges order[first + k] -> order[first + k + 1], gathering the
+// coordinates of both ends four edges at a time
+__attribute__((target("avx2")))
+static int tourEdgeLengthsAvx2(const TspProblem* problem, const int* order, int first, int count, double* out) {
+    int k = 0;
+    for (; k + 4 <= count; k += 4) {
+        __m128i from = _mm_loadu_si128((const __m128i*)(order + first + k));
+        __m128i to = _mm_loadu_si128((const __m128i*)(order + first + k + 1));
+        __m256d dx = _mm256_sub_pd(_mm256_i32gather_pd(problem->x, from, 8), _mm256_i32gather_pd(problem->x, to, 8));
+        __m256d dy = _mm256_sub_pd(_mm256_i32gather_pd(problem->y, from, 8), _mm256_i32gather_pd(problem->y, to, 8));
+        _mm256_storeu_pd(out + k, _mm256_sqrt_pd(_mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy))));
+    }
+    return k;
+}
+
+__attribute__((target("avx2")))
+static int distancesAvx2(const TspProblem* problem, int v, int first, int count, double* out) {
+    int k = 0;
+    if (problem->useFloat) {
+        __m256 px = _mm256_set1_ps(problem->xf[v]);
+        __m256 py = _mm256_set1_ps(problem->yf[v]);
+        for (; k + 8 <= count; k += 8) {
+            __m256 d = distance8f(px, py, problem->xf + first + k, problem->yf + first + k);
+            _mm256_storeu_pd(out + k, _mm256_cvtps_pd(_mm256_castps256_ps128(d)));
+            _mm256_storeu_pd(out + k + 4, _mm256_cvtps_pd(_mm256_extractf128_ps(d, 1)));
+        }
+    } else {
+        __m256d px = _mm256_set1_pd(problem->x[v]);
+        __m256d py = _mm256_set1_pd(problem->y[v]);
+        for (; k + 4 <= count; k += 4) {
+            _mm256_storeu_pd(out + k, distance4(px, py, problem->x + first + k, problem->y + first + k));
+        }
+    }
+    return k;
+}
+
+__attribute__((target("avx512f")))
+static int distancesAvx512(const TspProblem* problem, int v, int first, int count, double* out) {
+    int k = 0;
+    if (problem->useFloat) {
+        __m512 px = _mm512_set1_ps(problem->xf[v]);
+        __m512 py = _mm512_set1_ps(problem->yf[v]);
+        for (; k + 16 <= count; k += 16) {
+            __m512 d = distance16f(px, py, problem->xf + first + k, problem->yf + first + k);
+            _mm512_storeu_pd(out + k, lowHalf16(d));
+            _mm512_storeu_pd(out + k + 8, highHalf16(d));
+        }
+    } else {
+        __m512d px = _mm512_set1_pd(problem->x[v]);
+        __m512d py = _mm512_set1_pd(problem->y[v]);
+        for (; k + 8 <= count; k += 8) {
+            _mm512_storeu_pd(out + k, distance8(px, py, problem->x + first + k, problem->y + first + k));
+        }
+    }
+    return k;
+}
+
+__attribute__((target("avx2")))
+static int insertionCostsAvx2(const TspProblem* problem, int a, int b, int first, int count, double* out) {
+    __m256d ab = _mm256_set1_pd(getDistance(problem, a, b));
+    int k = 0;
+    if (problem->useFloat) {
+        __m256 ax = _mm256_set1_ps(problem->xf[a]), ay = _mm256_set1_ps(problem->yf[a]);
+        __m256 bx = _mm256_set1_ps(problem->xf[b]), by = _mm256_set1_ps(problem->yf[b]);
+        for (; k + 8 <= count; k += 8) {
+            const float* xs = problem->xf + first + k;
+            const float* ys = problem->yf + first + k;
+            __m256 da = distance8f(ax, ay, xs, ys);
+            __m256 db = distance8f(bx, by, xs, ys);
+            __m256d low = _mm256_add_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(da)), _mm256_cvtps_pd(_mm256_castps256_ps128(db)));
+            __m256d high = _mm256_add_pd(_mm256_cvtps_pd(_mm256_extractf128_ps(da, 1)), _mm256_cvtps_pd(_mm256_extractf128_ps(db, 1)));
+            _mm256_storeu_pd(out + k, _mm256_sub_pd(low, ab));
+            _mm256_storeu_pd(out + k + 4, _mm256_sub_pd(high, ab));
+        }
+    } else {
+        __m256d ax = _mm256_set1_pd(problem->x[a]), ay = _mm256_set1_pd(problem->y[a]);
+        __m256d bx = _mm256_set1_pd(problem->x[b]), by = _mm256_set1_pd(problem->y[b]);
+        for (; k + 4 <= count; k += 4) {
+            const double* xs = problem->x + first + k;
+            const double* ys = problem->y + first + k;
+            __m256d sum = _mm256_add_pd(distance4(ax, ay, xs, ys), distance4(bx, by, xs, ys));
+            _mm256_storeu_pd(out + k, _mm256_sub_pd(sum, ab));
+        }
+    }
+    return k;
+}
+
+__attribute__((target("avx512f")))
+static int insertionCostsAvx512(const TspProblem* problem, int a, int b, int first, int count, double* out) {
+    __m512d ab = _mm512_set1_pd(getDistance(problem, a, b));
+    int k = 0;
+    if (problem->useFloat) {
+        __m512 ax = _mm512_set1_ps(problem->xf[a]), ay = _mm512_set1_ps(problem->yf[a]);
+        __m512 bx = _mm512_set1_ps(problem->xf[b]), by = _mm512_set1_ps(problem->yf[b]);
+        for (; k + 16 <= count; k += 16) {
+            const float* xs = problem->xf + first + k;
+            const float* ys = problem->yf + first + k;
+            __m512 da = distance16f(ax, ay, xs, ys);
+            __m512 db = distance16f(bx, by, xs, ys);
+            _mm512_storeu_pd(out + k, _mm512_sub_pd(_mm512_add_pd(lowHalf16(da), lowHalf16(db)), ab));
+            _mm512_storeu_pd(out + k + 8, _mm512_sub_pd(_mm512_add_pd(highHalf16(da), highHalf16(db)), ab));
+        }
+    } else {
+        __m512d ax = _mm512_set1_pd(problem->x[a]), ay = _mm512_set1_pd(problem->y[a]);
+        __m512d bx = _mm512_set1_pd(problem->x[b]), by = _mm512_set1_pd(problem->y[b]);
+        for (; k + 8 <= count; k += 8) {
+            const double* xs = problem->x + first + k;
+            const double* ys = problem->y + first + k;
+            __m512d sum = _mm512_add_pd(distance8(ax, ay, xs, ys), distance8(bx, by, xs, ys));
+            _mm512_storeu_pd(out + k, _mm512_sub_pd(sum, ab));
+        }
+    }
+    return k;
+}
+
+// A vertex in every lane, the plane metrics leave z unused
+typedef struct {
+    __m256d x, y, z;
+} Lanes4;
+
+__attribute__((target("avx2")))
+static inline Lanes4 planeLanes4(const TspProblem* problem, int v) {
+    Lanes4 p = { _mm256_set1_pd(problem->x[v]), _mm256_set1_pd(problem->y[v]), _mm256_setzero_pd() };
+    return p;
+}
+
+__attribute__((target("avx2")))
+static inline Lanes4 sphereLanes4(const TspProblem* problem, int v) {
+    Lanes4 p = { _mm256_set1_pd(problem->ux[v]), _mm256_set1_pd(problem->uy[v]), _mm256_set1_pd(problem->uz[v]) };
+    return p;
+}
+
+// Metric distances from p to the vertices first .. first + 3, the same operations
+// as squaredBetween(), manhattanBetween() and haversineBetween()
+__attribute__((target("avx2")))
+static inline __m256d squared4(const TspProblem* problem, Lanes4 p, int first) {
+    __m256d dx = _mm256_sub_pd(p.x, _mm256_loadu_pd(problem->x + first));
+    __m256d dy = _mm256_sub_pd(p.y, _mm256_loadu_pd(problem->y + first));
+    return _mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy));
+}
+
+__attribute__((target("avx2")))
+static inline __m256d manhattan4(const TspProblem* problem, Lanes4 p, int first) {
+    __m256d sign = _mm256_set1_pd(-0.0);
+    __m256d dx = _mm256_andnot_pd(sign, _mm256_sub_pd(p.x, _mm256_loadu_pd(problem->x + first)));
+    __m256d dy = _mm256_andnot_pd(sign, _mm256_sub_pd(p.y, _mm256_loadu_pd(problem->y + first)));
+    return _mm256_add_pd(dx, dy);
+}
+
+// arcSine() in each lane, both of its branches blended
+__attribute__((target("avx2")))
+static inline __m256d arcSine4(__m256d s) {
+    __m256d low = _mm256_cmp_pd(s, _mm256_set1_pd(0.5), _CMP_LE_OQ);
+    __m256d high = _mm256_mul_pd(_mm256_sub_pd(_mm256_set1_pd(1.0), s), _mm256_set1_pd(0.5));
+    __m256d z = _mm256_blendv_pd(high, _mm256_mul_pd(s, s), low);
+    __m256d p = _mm256_add_pd(_mm256_set1_pd(ASIN_P4), _mm256_mul_pd(z, _mm256_set1_pd(ASIN_P5)));
+    p = _mm256_add_pd(_mm256_set1_pd(ASIN_P3), _mm256_mul_pd(z, p));
+    p = _mm256_add_pd(_mm256_set1_pd(ASIN_P2), _mm256_mul_pd(z, p));
+    p = _mm256_add_pd(_mm256_set1_pd(ASIN_P1), _mm256_mul_pd(z, p));
+    p = _mm256_mul_pd(z, _mm256_add_pd(_mm256_set1_pd(ASIN_P0), _mm256_mul_pd(z, p)));
+    __m256d q = _mm256_add_pd(_mm256_set1_pd(ASIN_Q3), _mm256_mul_pd(z, _mm256_set1_pd(ASIN_Q4)));
+    q = _mm256_add_pd(_mm256_set1_pd(ASIN_Q2), _mm256_mul_pd(z, q));
+    q = _mm256_add_pd(_mm256_set1_pd(ASIN_Q1), _mm256_mul_pd(z, q));
+    q = _mm256_add_pd(_mm256_set1_pd(1.0), _mm256_mul_pd(z, q));
+    __m256d w = _mm256_blendv_pd(_mm256_sqrt_pd(z), s, low);
+    __m256d r = _mm256_add_pd(w, _mm256_mul_pd(w, _mm256_div_pd(p, q)));
+    __m256d reflected = _mm256_sub_pd(_mm256_set1_pd(HALF_PI), _mm256_mul_pd(_mm256_set1_pd(2.0), r));
+    return _mm256_blendv_pd(reflected, r, low);
+}
+
+__attribute__((target("avx2")))
+static inline __m256d haversine4(const TspProblem* problem, Lanes4 p, int first) {
+    __m256d dx = _mm256_sub_pd(p.x, _mm256_loadu_pd(problem->ux + first));
+    __m256d dy = _mm256_sub_pd(p.y, _mm256_loadu_pd(problem->uy + first));
+    __m256d dz = _mm256_sub_pd(p.z, _mm256_loadu_pd(problem->uz + first));
+    __m256d chord2 = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy)), _mm256_mul_pd(dz, dz));
+    __m256d half = _mm256_min_pd(_mm256_mul_pd(_mm256_set1_pd(0.5), _mm256_sqrt_pd(chord2)), _mm256_set1_pd(1.0));
+    return _mm256_mul_pd(_mm256_set1_pd(2.0 * EARTH_RADIUS_KM), arcSine4(half));
+}
+
+// AVX2 kernels of a metric, generated for each from its lane loader and distance
+#define AVX2_METRIC_KERNELS(name, lanes, distance4)                                                           \
+    __attribute__((target("avx2")))                                                                            \
+    static int distancesAvx2##name(const TspProblem* problem, int v, int first, int count, double* out) {     \
+        Lanes4 p = lanes(problem, v);                                                                          \
+        int k = 0;                                                                                             \
+        for (; k + 4 <= count; k += 4) {                                                                       \
+            _mm256_storeu_pd(out + k, distance4(problem, p, first + k));                                       \
+        }                                                                                                      \
+        return k;                                                                                              \
+    }                                                                                                          \
+                                                                                                               \
+    __attribute__((target("avx2")))                                                                            \
+    static int insertionCostsAvx2##name(const TspProblem* problem, int a, int b, double ab, int first, int count, \
+                                        double* out) {                                                         \
+        Lanes4 pa = lanes(problem, a);                                                                         \
+        Lanes4 pb = lanes(problem, b);                                                                         \
+        __m256d edge = _mm256_set1_pd(ab);                                                                     \
+        int k = 0;                                                                                             \
+        for (; k + 4 <= count; k += 4) {                                                                       \
+            __m256d sum = _mm256_add_pd(distance4(problem, pa, first + k), distance4(problem, pb, first + k)); \
+            _mm256_storeu_pd(out + k, _mm256_sub_pd(sum, edge));                                               \
+        }                                                                                                      \
+        return k;                                                                                              \
+    }
+
+AVX2_METRIC_KERNELS(Squared, planeLanes4, squared4)
+AVX2_METRIC_KERNELS(Manhattan, planeLanes4, manhattan4)
+AVX2_METRIC_KERNELS(Haversine, sphereLanes4, haversine4)
+
+#define AVX2_KERNEL(call) (problem->simdLevel >= 1 ? (call) : 0)
+#else
+#define AVX2_KERNEL(call) 0
+#endif
+
+// On-the-fly batch kernels of the metrics other than the straight line, generated
+// for each so the AVX2 lanes and the scalar rest inline its distance
+#define METRIC_KERNELS(name, between)                                                                         \
+    static void distances##name(const TspProblem* problem, int v, int first, int count, double* out) {        \
+        int k = AVX2_KERNEL(distancesAvx2##name(problem, v, first, count, out));                               \
+        for (; k < count; k++) {                                                                               \
+            out[k] = between(problem, v, first + k);                                                           \
+        }                                                                                                      \
+    }                                                                                                          \
+                                                                                                               \
+    static void insertionCosts##name(const TspProblem* problem, int a, int b, int first, int count, double* out) { \
+        double ab = between(problem, a, b);                                                                    \
+        int k = AVX2_KERNEL(insertionCostsAvx2##name(problem, a, b, ab, first, count, out));                   \
+        for (; k < count; k++) {                                                                               \
+            out[k] = between(problem, a, first + k) + between(problem, first + k, b) - ab;                     \
+        }                                                                                                      \
+    }
+
+METRIC_KERNELS(Squared, squaredBetween)
+METRIC_KERNELS(Manhattan, manhattanBetween)
+METRIC_KERNELS(Haversine, haversineBetween)
+
+// Distances from v in the packed triangle. Those to vertices after v are one
+// contiguous run of row v; those before v are spread over earlier rows.
+static void packedDistancesFrom(const TspProblem* problem, int v, int first, int count, double* out) {
+    int k = 0;
+    for (; k < count && first + k <= v; k++) {
+        out[k] = getDistance(problem, v, first + k);
+    }
+    if (k == count) {
+        return;
+    }
+
+    size_t row = packedRow(problem->numOfCoords, v) + (first + k - v - 1);
+    if (problem->packed) {
+        memcpy(out + k, problem->packed + row, (count - k) * sizeof(double));
+    } else {
+        for (int m = k; m < count; m++) {
+            out[m] = problem->packedf[row + (m - k)];
+        }
+    }
+}
+
+// Distances computed from the coordinates with the widest kernel the CPU has. The
+// metric is chosen once per batch, each of its kernels inlines it.
+static void onTheFlyDistances(const TspProblem* problem, int v, int first, int count, double* out) {
+    switch (problem->metric) {
+    case METRIC_SQUARED:
+        distancesSquared(problem, v, first, count, out);
+        return;
+    case METRIC_MANHATTAN:
+        distancesManhattan(problem, v, first, count, out);
+        return;
+    case METRIC_HAVERSINE:
+        distancesHaversine(problem, v, first, count, out);
+        return;
+    default:
+        break;
+    }
+
+    int done = 0;
+#ifdef TSP_X86_KERNELS
+    if (problem->simdLevel == 2) {
+        done = distancesAvx512(problem, v, first, count, out);
+    } else if (problem->simdLevel == 1) {
+        done = distancesAvx2(problem, v, first, count, out);
+    }
+#endif
+    distancesScalar(problem, v, first + done, count - done, out + done);
+}
+
+// Exact lengths of count tour edges from the double coordinates, whatever the distance table
+static void tourEdgeLengths(const TspProblem* problem, const int* order, int first, int count, double* out) {
+    int done = 0;
+#ifdef TSP_X86_KERNELS
+    if (problem->simdLevel >= 1 && problem->metric == METRIC_EUCLIDEAN) {
+        done = tourEdgeLengthsAvx2(problem, order, first, count, out);
+    }
+#endif
+    for (int k = done; k < count; k++) {
+        out[k] = coordinateDistance(problem, order[first + k], order[first + k + 1]);
+    }
+}
+
+void distancesFrom(const TspProblem* problem, int v, int first, int count, double* out) {
+    if (problem->distanceMatrix) {
+        memcpy(out, problem->distanceMatrix + (size_t)v * problem->numOfCoords + first, count * sizeof(double));
+        return;
+    }
+    if (problem->packed || problem->packedf) {
+        packedDistancesFrom(problem, v, first, count, out);
+        return;
+    }
+    onTheFlyDistances(problem, v, first, count, out);
+}
+
+void insertionCosts(const TspProblem* problem, int a, int b, int first, int count, double* out) {
+    if (problem->distanceMatrix) {
+        // The matrix is symmetric, so d(i, b) is read from row b with unit stride
+        const double* rowA = problem->distanceMatrix + (size_t)a * problem->numOfCoords + first;
+        const double* rowB = problem->distanceMatrix + (size_t)b * problem->numOfCoords + first;
+        double ab = getDistance(problem, a, b);
+        for (int k = 0; k < count; k++) {
+            out[k] = rowA[k] + rowB[k] - ab;
+        }
+        return;
+    }
+    if (problem->packed || problem->packedf) {
+        double ab = getDistance(problem, a, b);
+        packedDistancesFrom(problem, a, first, count, out);
+        for (int k = 0; k < count; k++) {
+            out[k] = out[k] + getDistance(problem, first + k, b) - ab;
+        }
+        return;
+    }
+    switch (problem->metric) {
+    case METRIC_SQUARED:
+        insertionCostsSquared(problem, a, b, first, count, out);
+        return;
+    case METRIC_MANHATTAN:
+        insertionCostsManhattan(problem, a, b, first, count, out);
+        return;
+    case METRIC_HAVERSINE:
+        insertionCostsHaversine(problem, a, b, first, count, out);
+        return;
+    default:
+        break;
+    }
+
+    int done = 0;
+#ifdef TSP_X86_KERNELS
+    if (problem->simdLevel == 2) {
+        done = insertionCostsAvx512(problem, a, b, first, count, out);
+    } else if (problem->simdLevel == 1) {
+        done = insertionCostsAvx2(problem, a, b, first, count, out);
+    }
+#endif
+    insertionCostsScalar(problem, a, b, first + done, count - done, out + done);
+}
@@ -0,0 +1,392 @@
+// tspProblem.h
+// Input-sized problem context shared by all solvers. Build it into each binary,
+// e.g. gcc cInsertion.c cheapestInsertion.c batch.c tspProblem.c tspTour.c twoLevelList.c localSearch.c -o cInsertion -lm
+// With -fopenmp the distance tables are also built in parallel.
+#ifndef TSP_PROBLEM_H
+#define TSP_PROBLEM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <math.h>
+
+#define MAX_COORDS (1 << 24) // Largest input accepted, keeps vertex ids and sizes in range
+#define SCORE_BLOCK 256 // Candidates scored per call to the batch distance kernels
+#define MAX_INSERT_BATCH 4096 // Most vertices a parallel insertion round may insert
+#define DISTANCE_TILE 64 // Rows and columns per tile when building the distance tables
+
+// Binary coordinate and tour files: a 32-byte little-endian BinaryHeader followed by
+// the payload, all x then all y for coordinates and the vertex ids for tours. Payloads
+// start 8-byte aligned, so a mapped file can be used in place.
+#define BINARY_COORDS_MAGIC 0x43505354u // "TSPC" stored little-endian
+#define BINARY_TOUR_MAGIC 0x54505354u // "TSPT"
+#define BINARY_FORMAT_VERSION 1
+
+typedef enum {
+    ELEMENT_F32 = 1,
+    ELEMENT_F64 = 2,
+    ELEMENT_U32 = 3
+} BinaryElementType;
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t elementType;
+    uint64_t count; // points, or vertices of the open tour
+    uint64_t checksum; // binaryChecksum() of the payload
+    uint64_t reserved; // 0
+} BinaryHeader;
+
+// How distances are obtained
+typedef enum {
+    DISTANCES_MATRIX, // precomputed n x n matrix
+    DISTANCES_PACKED, // precomputed upper triangle, n(n-1)/2 entries
+    DISTANCES_NONE // computed on the fly from the coordinates, O(n) memory
+} DistanceMode;
+
+// How the distance of two points is measured
+typedef enum {
+    METRIC_EUCLIDEAN, // straight line in the plane
+    METRIC_SQUARED, // square of the straight line, which makes long edges costlier
+    METRIC_MANHATTAN, // sum of the differences along each axis
+    METRIC_HAVERSINE // great circle in kilometres between points given as latitude,longitude in degrees
+} DistanceMetric;
+
+#define EARTH_RADIUS_KM 6371.0088 // mean radius of the Earth
+
+// Options shared by the solver command lines
+typedef struct {
+    DistanceMode distanceMode;
+    DistanceMetric metric;
+    int useFloat; // single precision packed or on-the-fly distances
+    int numNeighbors; // k of the nearest neighbour candidate lists, 0 for full scans
+    int optimize; // improve the constructed tour with local search
+    double timeLimit; // seconds the local search may run, 0 for no limit
+    long maxMoves; // improving moves the local search may make, 0 for no limit
+    int binaryOutput; // write the tour in the binary format
+    int hilbertOrder; // renumber the vertices along a Hilbert curve before the tables are built
+    int numStarts; // tours built from different start vertices, the shortest is kept
+    double startTimeLimit; // seconds the starts after the first may run, 0 for no limit
+    int insertBatch; // vertices the OpenMP cheapest insertion may insert per round
+    double insertTolerance; // relative excess over the round's cheapest insertion the others may have
+    int partitionSize; // most vertices of a partition the serial solvers solve apart, 0 for none, not with numStarts > 1
+} TspOptions;
+
+// Uniform grid over the bounding box of the vertices with about two vertices per
+// square cell. Cell c = row * cols + column holds cellVertices[cellStart[c] .. cellStart[c + 1]).
+typedef struct {
+    double minX, minY; // corner of cell 0
+    double cellSize;
+    int cols, rows;
+    int* cellStart; // cols * rows + 1 offsets into cellVertices
+    int* cellVertices; // vertex ids sorted by cell, by id within a cell
+    int* cellOf; // cell of each vertex
+    void* candidates; // a list per thread for neighbour searches too long for the stack
+    size_t cellStartBytes, cellVerticesBytes, cellOfBytes, candidatesBytes; // allocated sizes, the buffers only grow
+} SpatialGrid;
+
+typedef struct {
+    int numOfCoords; // number of coordinates read from file
+    double* x; // x coordinates read from file
+    double* y; // y coordinates read from file
+    float* xf; // single precision copies, only when useFloat is set
+    float* yf;
+    int useFloat;
+    int simdLevel; // 0 scalar, 1 AVX2, 2 AVX-512, detected once per problem
+    DistanceMetric metric; // the metric of every distance, tables included
+    double* ux; // unit vectors of the points on the sphere, only for METRIC_HAVERSINE,
+    double* uy; // all three in one buffer
+    double* uz;
+    double* distanceMatrix; // numOfCoords x numOfCoords distances, row-major, NULL unless DISTANCES_MATRIX
+    double* packed; // d(i, j) for i < j, row by row, NULL unless DISTANCES_PACKED in double precision
+    float* packedf; // the same in single precision
+    void* table; // storage the distance matrix or packed distances point into
+    int numNeighbors; // k of the nearest neighbour lists, 0 when they are not built
+    int* neighbors; // numOfCoords x numNeighbors nearest vertices, closest first
+    int* reverseStart; // vertices listing v as a neighbour are reverseNeighbors[reverseStart[v] .. reverseStart[v + 1])
+    int* reverseNeighbors;
+    SpatialGrid grid; // buckets of the last neighbour list search, kept for its buffers
+    TspOptions options; // options the problem was prepared with
+    void* mapping; // binary input x and y point into, unmapped by freeProblem(), or NULL
+    size_t mappingSize;
+    int reordered; // vertices are numbered along a Hilbert curve, see originalVertex()
+    int* originalId; // input id of each vertex when reordered
+    int* reorderedId; // the inverse, vertex of each input id
+    // Bytes allocated behind each buffer. Buffers only grow, so a problem reused
+    // through loadCoordinates() stops allocating once it has held its largest input.
+    size_t xBytes, yBytes, xfBytes, yfBytes, sphereBytes, tableBytes;
+    size_t neighborBytes, reverseStartBytes, reverseNeighborBytes, originalIdBytes, reorderedIdBytes;
+} TspProblem;
+
+// Parse the options following the file names, 0 on success and -1 on an unknown option
+int parseOptions(int argc, char* argv[], TspOptions* options);
+
+// Fill in the options a command line without any would give
+void defaultOptions(TspOptions* options);
+
+// Whether the options are valid together, 0 if they are and -1 after naming the problem on stderr
+int checkOptions(const TspOptions* options);
+void printOptionsUsage(void);
+
+// Monotonic wall-clock time in seconds
+double wallTime(void);
+
+// With --timings, print "phase <name> <seconds>" on stderr for the time since the
+// calling thread's previous phase ended, or since the options were parsed. With
+// --stats it is followed by the phase's non-zero counts, one
+// "counter <name> <event> <value>" line each, and "thread <name> <id> <busy> <idle>"
+// for the threads of its parallel loops. With --perf "perf <name> <event> <value>"
+// lines give the hardware counters of the whole process over the phase.
+void endPhase(const char* name);
+
+// Restart the calling thread's phase timer, as each batch instance does
+void startPhases(void);
+
+// Events counted for --stats
+typedef enum {
+    COUNT_STEPS, // construction steps, one per vertex inserted or edge taken
+    COUNT_CANDIDATES, // insertion costs of a vertex on an edge or candidate edges evaluated
+    COUNT_DISTANCES, // distances evaluated to bring vertices' nearest tour distances up to date
+    COUNT_MOVES, // improving local search moves
+    COUNT_STARTS, // tours built from different start vertices
+    COUNT_ROUNDS, // synchronised rounds of a parallel construction
+    COUNT_KINDS
+} CountKind;
+
+// Counts of the calling thread's current phase. Parallel loops sum theirs and add
+// them once after the loop, so only the thread that ends the phase counts.
+extern _Thread_local long phaseCounts[COUNT_KINDS];
+
+static inline void addCount(CountKind kind, long amount) {
+    phaseCounts[kind] += amount;
+}
+
+// Whether --stats is on, so solvers only time their parallel loops when asked
+int statsEnabled(void);
+
+// Seconds an OpenMP thread spent in the work of the current phase's parallel loops,
+// and wall time of those loops; the rest of it is reported as the thread's idle time.
+// Like the counts they are added by the thread running the phase, after the loops.
+void addThreadBusy(int thread, double seconds);
+void addParallelTime(double seconds);
+
+// Read a file of "x,y" lines, or a binary coordinate file, into a new problem, NULL on
+// failure. Reading text stops at the first record that is not two plain decimal numbers.
+TspProblem* readCoordinates(const char* filename);
+
+// Read a coordinate file like readCoordinates() into an existing problem, reusing its
+// buffers and dropping its distance tables. Binary input is copied rather than used
+// in place. 0 on success and -1 on failure, which leaves the problem empty but reusable.
+int loadCoordinates(TspProblem* problem, const char* filename);
+
+// Empty an existing problem like loadCoordinates() and make room for numOfCoords
+// coordinates, which the caller fills in x and y. 0 on success and -1 on failure.
+int resetCoordinates(TspProblem* problem, int numOfCoords);
+
+// Write the coordinates as "x,y" lines that read back exactly, 0 on success and -1 on failure
+int writeTextCoordinates(const TspProblem* problem, const char* filename);
+
+// Write the coordinates in the binary format, as f32 with useFloat and f64 otherwise,
+// 0 on success and -1 on failure
+int writeBinaryCoordinates(const TspProblem* problem, const char* filename, int useFloat);
+
+// Checksum of a binary payload, FNV-1a over its little-endian 64-bit words with the
+// last one padded with zero bytes
+uint64_t binaryChecksum(const void* data, size_t size);
+
+// Write a header and the payload given in numParts consecutive parts, 0 on success and -1 on failure
+int writeBinaryFile(const char* filename, uint32_t magic, BinaryElementType elementType, uint64_t count,
+                    const void* const parts[], const size_t partSizes[], int numParts);
+
+// Decode the header at data and check it against the magic, the file size and the
+// payload checksum, 0 if it holds and -1 after reporting the problem on stderr
+int checkBinaryHeader(const void* data, size_t size, const char* filename, uint32_t magic, BinaryHeader* header);
+
+// Map a file privately, or read it into memory when it cannot be mapped, NULL on failure
+void* mapInputFile(const char* filename, size_t* size, int* mapped);
+
+void releaseInputFile(void* data, size_t size, int mapped);
+
+// Set up distance lookups for the chosen mode, 0 on success and -1 on failure. A
+// problem split into partitions builds no table, each partition builds its own.
+int prepareDistances(TspProblem* problem, const TspOptions* options);
+
+// Fill the distance matrix, growing the problem's table as needed, 0 on success and -1 on failure
+int calculateDistanceMatrix(TspProblem* problem);
+
+// Fill the packed upper triangle, growing the problem's table as needed, 0 on success and -1 on failure
+int calculatePackedDistances(TspProblem* problem, int useFloat);
+
+// Renumber the vertices in the order a Hilbert curve over the bounding box visits them,
+// rotated so that vertex 0 keeps its id, 0 on success and -1 on failure. Nearby vertices
+// get nearby ids, so later phases touch memory with more locality. Call before the
+// distance tables are built, prepareDistances() does with options->hilbertOrder.
+int reorderHilbert(TspProblem* problem);
+
+// Turn a tour of vertex ids into the input numbering, or back, in place
+void toOriginalIds(const TspProblem* problem, int* order, int count);
+void toReorderedIds(const TspProblem* problem, int* order, int count);
+
+// Input id of vertex v, which tours are written with
+static inline int originalVertex(const TspProblem* problem, int v) {
+    return problem->reordered ? problem->originalId[v] : v;
+}
+
+// Build the k nearest neighbour lists by grid bucketing, 0 on success and -1 on failure
+int buildNeighborLists(TspProblem* problem, int k);
+
+// Half of hi - lo, which unlike the difference stays finite for any finite bounds
+static inline double halfSpan(double lo, double hi) {
+    return 0.5 * hi - 0.5 * lo;
+}
+
+// Bucket the problem's vertices into the grid, reusing the grid's buffers from an
+// earlier call. Start from a zeroed grid. 0 on success and -1 on failure.
+int buildSpatialGrid(const TspProblem* problem, SpatialGrid* grid);
+
+void freeSpatialGrid(SpatialGrid* grid);
+
+// Smallest distance from (x, y) to a point of the grid cell at column cx and row cy
+static inline double cellDistance(const SpatialGrid* grid, double x, double y, int cx, int cy) {
+    double left = grid->minX + cx * grid->cellSize;
+    double bottom = grid->minY + cy * grid->cellSize;
+    double dx = x < left ? left - x : (x > left + grid->cellSize ? x - left - grid->cellSize : 0.0);
+    double dy = y < bottom ? bottom - y : (y > bottom + grid->cellSize ? y - bottom - grid->cellSize : 0.0);
+    return sqrt(dx * dx + dy * dy);
+}
+
+// The k < numOfCoords nearest neighbours of every vertex, closest first, in a new
+// numOfCoords x k array, NULL on failure
+int* findNearestNeighbors(const TspProblem* problem, int k);
+
+// findNearestNeighbors() into an existing numOfCoords x k array, bucketing the vertices
+// in grid and reusing its buffers. 0 on success and -1 on failure.
+int fillNearestNeighbors(const TspProblem* problem, int k, int* neighbors, SpatialGrid* grid);
+
+void freeProblem(TspProblem* problem);
+
+double euclideanDistance(double x1, double y1, double x2, double y2);
+
+// Distance between the points (x1, y1) and (x2, y2) in the metric, for points that are
+// not vertices of a problem
+double pointDistance(DistanceMetric metric, double x1, double y1, double x2, double y2);
+
+// Largest straight-line distance in the coordinate plane between two points at most
+// distance apart in the problem's metric, DBL_MAX when the metric does not bound it
+double planarReach(const TspProblem* problem, double distance);
+
+// Length of the closed tour visiting order[0 .. numOfCoords - 1], from the double
+// coordinates whatever the distance table, with pairwise and compensated summation
+double tourLength(const TspProblem* problem, const int* order);
+
+// Distances from vertex v to each of the vertices first .. first + count - 1
+void distancesFrom(const TspProblem* problem, int v, int first, int count, double* out);
+
+// Increase in tour length of inserting each of the vertices first .. first + count - 1
+// on the edge (a, b), that is d(a, i) + d(i, b) - d(a, b)
+void insertionCosts(const TspProblem* problem, int a, int b, int first, int count, double* out);
+
+// The numNeighbors nearest vertices of v, closest first
+static inline const int* neighborsOf(const TspProblem* problem, int v) {
+    return problem->neighbors + (size_t)v * problem->numNeighbors;
+}
+
+// Offset of row i, the distances d(i, j) for j > i, in the packed upper triangle
+static inline size_t packedRow(int n, int i) {
+    return (size_t)i * (2 * (size_t)n - i - 1) / 2;
+}
+
+// Distances between vertices i and j from the double coordinates, one per metric.
+// The batch kernels are generated once for each of them, so the metric is inlined
+// into their loops rather than chosen per distance.
+static inline double euclideanBetween(const TspProblem* problem, int i, int j) {
+    double dx = problem->x[i] - problem->x[j];
+    double dy = problem->y[i] - problem->y[j];
+    return sqrt(dx * dx + dy * dy);
+}
+
+static inline double squaredBetween(const TspProblem* problem, int i, int j) {
+    double dx = problem->x[i] - problem->x[j];
+    double dy = problem->y[i] - problem->y[j];
+    return dx * dx + dy * dy;
+}
+
+static inline double manhattanBetween(const TspProblem* problem, int i, int j) {
+    return fabs(problem->x[i] - problem->x[j]) + fabs(problem->y[i] - problem->y[j]);
+}
+
+// Coefficients of the rational approximation of asin() from fdlibm
+#define ASIN_P0 1.66666666666666657415e-01
+#define ASIN_P1 -3.25565818622400915405e-01
+#define ASIN_P2 2.01212532134862925881e-01
+#define ASIN_P3 -4.00555345006794114027e-02
+#define ASIN_P4 7.91534994289814532176e-04
+#define ASIN_P5 3.47933107596021167570e-05
+#define ASIN_Q1 -2.40339491173441421878e+00
+#define ASIN_Q2 2.02094576023350569471e+00
+#define ASIN_Q3 -6.88283971605453293030e-01
+#define ASIN_Q4 7.70381505559019352791e-02
+#define HALF_PI 1.57079632679489661923
+
+// asin(s) for 0 <= s <= 1 with only arithmetic and sqrt, which the SIMD kernels
+// repeat lane by lane so both give the same bits. Above 1/2 it is taken from
+// asin(s) = pi/2 - 2 asin(sqrt((1 - s) / 2)).
+static inline double arcSine(double s) {
+    int low = s <= 0.5;
+    double z = low ? s * s : (1.0 - s) * 0.5;
+    double p = z * (ASIN_P0 + z * (ASIN_P1 + z * (ASIN_P2 + z * (ASIN_P3 + z * (ASIN_P4 + z * ASIN_P5)))));
+    double q = 1.0 + z * (ASIN_Q1 + z * (ASIN_Q2 + z * (ASIN_Q3 + z * ASIN_Q4)));
+    double w = low ? s : sqrt(z);
+    double r = w + w * (p / q);
+    return low ? r : HALF_PI - 2.0 * r;
+}
+
+// Haversine formula with the haversine of the central angle, the square of half the
+// chord between the unit vectors, so no trigonometry is left per distance
+static inline double haversineBetween(const TspProblem* problem, int i, int j) {
+    double dx = problem->ux[i] - problem->ux[j];
+    double dy = problem->uy[i] - problem->uy[j];
+    double dz = problem->uz[i] - problem->uz[j];
+    double half = 0.5 * sqrt(dx * dx + dy * dy + dz * dz);
+    return 2.0 * EARTH_RADIUS_KM * arcSine(half < 1.0 ? half : 1.0);
+}
+
+// Distance between vertices i and j from the double coordinates in the problem's metric
+static inline double coordinateDistance(const TspProblem* problem, int i, int j) {
+    switch (problem->metric) {
+    case METRIC_SQUARED:
+        return squaredBetween(problem, i, j);
+    case METRIC_MANHATTAN:
+        return manhattanBetween(problem, i, j);
+    case METRIC_HAVERSINE:
+        return haversineBetween(problem, i, j);
+    default:
+        return euclideanBetween(problem, i, j);
+    }
+}
+
+// Distance between vertices i and j
+static inline double getDistance(const TspProblem* problem, int i, int j) {
+    if (problem->distanceMatrix) {
+        return problem->distanceMatrix[(size_t)i * problem->numOfCoords + j];
+    }
+    if (problem->packed || problem->packedf) {
+        if (i == j) {
+            return 0.0;
+        }
+        if (i > j) {
+            int swap = i;
+            i = j;
+            j = swap;
+        }
+        size_t index = packedRow(problem->numOfCoords, i) + (j - i - 1);
+        return problem->packed ? problem->packed[index] : problem->packedf[index];
+    }
+    if (problem->useFloat) {
+        float dx = problem->xf[i] - problem->xf[j];
+        float dy = problem->yf[i] - problem->yf[j];
+        return sqrtf(dx * dx + dy * dy);
+    }
+    return coordinateDistance(problem, i, j);
+}
+
+#endif
@@ -0,0 +1,79 @@
+// tspSolver.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "tspSolver.h"
+
+int solveTour(SolveContext* context, SolveMethod method, const double* x, const double* y, int numOfCoords,
+              const TspOptions* options, int* order) {
+    if (numOfCoords < 1 || numOfCoords > MAX_COORDS) {
+        fprintf(stderr, "Error: %d points, not 1 .. %d\n", numOfCoords, MAX_COORDS);
+        return -1;
+    }
+    if (checkOptions(options) != 0) {
+        return -1;
+    }
+    for (int i = 0; i < numOfCoords; i++) {
+        if (!isfinite(x[i]) || !isfinite(y[i])) {
+            fprintf(stderr, "Error: point %d is not finite\n", i);
+            return -1;
+        }
+    }
+
+    // The problem and its tables are refilled in place, only growing
+    if (!context->problem) {
+        context->problem = calloc(1, sizeof(TspProblem));
+        if (!context->problem) {
+            perror("Memory allocation for solve context failed");
+            return -1;
+        }
+    }
+    TspProblem* problem = context->problem;
+    if (resetCoordinates(problem, numOfCoords) != 0) {
+        return -1;
+    }
+    memcpy(problem->x, x, numOfCoords * sizeof(double));
+    memcpy(problem->y, y, numOfCoords * sizeof(double));
+    if (prepareDistances(problem, options) != 0) {
+        return -1;
+    }
+
+    const int* tour;
+    if (method == SOLVE_CHEAPEST_INSERTION) {
+        if (cheapestInsertionTour(problem, &context->cheapest) != 0) {
+            return -1;
+        }
+        tour = context->cheapest.order;
+    } else if (method == SOLVE_FARTHEST_INSERTION) {
+        if (farthestInsertionTour(problem, &context->farthest) != 0) {
+            return -1;
+        }
+        tour = context->farthest.order;
+    } else if (method == SOLVE_PARALLEL_CHEAPEST_INSERTION) {
+        if (parallelCheapestInsertionTour(problem, &context->parallelCheapest) != 0) {
+            return -1;
+        }
+        tour = context->parallelCheapest.order;
+    } else if (method == SOLVE_PARALLEL_FARTHEST_INSERTION) {
+        if (parallelFarthestInsertionTour(problem, &context->parallelFarthest) != 0) {
+            return -1;
+        }
+        tour = context->parallelFarthest.order;
+    } else {
+        fprintf(stderr, "Error: unknown solve method %d\n", (int)method);
+        return -1;
+    }
+    memcpy(order, tour, numOfCoords * sizeof(int));
+    toOriginalIds(problem, order, numOfCoords);
+    return 0;
+}
+
+void releaseSolveContext(SolveContext* context) {
+    freeProblem(context->problem);
+    releaseCheapestWorkspace(&context->cheapest);
+    releaseFarthestWorkspace(&context->farthest);
+    releaseParallelCheapestWorkspace(&context->parallelCheapest);
+    releaseParallelFarthestWorkspace(&context->parallelFarthest);
+    memset(context, 0, sizeof(SolveContext));
+}
@@ -0,0 +1,132 @@
+// tspSolver.h
+// Solver library: the serial insertion constructions, which cInsertion and fInsertion
+// wrap, their OpenMP versions, which ompcInsertion and ompfInsertion wrap, and a solve
+// context for programs that hold their coordinates in memory and want the tour back
+// in memory. Build it as a static library with
+// gcc -O2 -c tspSolver.c cheapestInsertion.c farthestInsertion.c parallelCheapestInsertion.c parallelFarthestInsertion.c batch.c tspProblem.c tspTour.c twoLevelList.c localSearch.c
+// ar rcs libtspsolver.a tspSolver.o cheapestInsertion.o farthestInsertion.o parallelCheapestInsertion.o parallelFarthestInsertion.o batch.o tspProblem.o tspTour.o twoLevelList.o localSearch.o
+// adding -fopenmp for parallel starts, partitions and OpenMP constructions, which
+// otherwise run on one thread. Every function reports failure
+// by its return value and never exits. Contexts are independent, so different threads
+// may solve on different contexts at once. The --timings, --stats and --perf reports
+// are the exception: parseOptions() switches them on for the whole process, so call
+// it before the solving threads start. The counts and times are kept by each thread
+// for its own solves, but the --perf counters cover the whole process.
+#ifndef TSP_SOLVER_H
+#define TSP_SOLVER_H
+
+#include "tspProblem.h"
+#include "tspTour.h"
+#include "localSearch.h"
+#include "batch.h"
+
+// Buffers of cheapestInsertionTour(), kept between instances. A zeroed one is empty.
+typedef struct {
+    int capacity; // vertices the buffers hold
+    TspTour* tour;
+    int* visited;
+    int* bestFrom;
+    double* bestIncrease;
+    int* restricted;
+    int* order; // the finished tour, in output order
+    LocalSearchBuffers search; // buffers of --optimize
+    StartTeam starts; // workspaces of the threads building tours with --starts
+    PartitionTeam partitions; // workspaces of the threads building partitions with --partition
+} CheapestWorkspace;
+
+// Buffers of farthestInsertionTour(), kept between instances. A zeroed one is empty.
+typedef struct {
+    int capacity; // vertices the buffers hold
+    TspTour* tour;
+    int* visited;
+    double* minDistance; // distance from every unvisited vertex to its nearest tour vertex
+    int* heap; // unvisited vertices, max-heap on minDistance with ties to the lowest id
+    int* heapPos; // slot of each unvisited vertex in the heap
+    SpatialGrid grid;
+    int* cellFirst; // the unvisited vertices of cell c are grid.cellVertices[cellFirst[c] .. grid.cellStart[c + 1])
+    int cellCapacity; // cells cellFirst holds
+    int* gridPos; // index of each vertex in grid.cellVertices
+    int* order; // the finished tour, in output order
+    LocalSearchBuffers search; // buffers of --optimize
+    StartTeam starts; // workspaces of the threads building tours with --starts
+    PartitionTeam partitions; // workspaces of the threads building partitions with --partition
+} FarthestWorkspace;
+
+// Buffers of parallelCheapestInsertionTour(), kept between instances. A zeroed one is empty.
+typedef struct {
+    int capacity; // vertices the buffers hold
+    TspTour* tour;
+    int* visited;
+    int* bestFrom;
+    double* bestIncrease;
+    char* split; // vertices whose outgoing edge the last round split
+    int* order; // the finished tour, in output order
+    int roundCapacity; // vertices a round and a thread's list hold
+    int* roundFrom; // round vertex j split the edge (roundFrom[j], roundTo[j])
+    int* roundVertex;
+    int* roundTo;
+    int numThreads; // lists allocated
+    int listStride; // candidates from one thread's list to the next, whole cache lines
+    void* lists; // the cheapest vertices each thread found in a pass
+    int* listSizes;
+    void* merged; // every thread's list, sorted
+    double* busy; // seconds each thread spent in the loops, for --stats
+    LocalSearchBuffers search; // buffers of --optimize
+} ParallelCheapestWorkspace;
+
+// Buffers of parallelFarthestInsertionTour(), kept between instances. A zeroed one is empty.
+typedef struct {
+    int capacity; // vertices the buffers hold
+    TspTour* tour;
+    int* visited;
+    double* minDistance; // distance from every unvisited vertex to its nearest tour vertex
+    int* order; // the finished tour, in output order
+    int numThreads; // busy times allocated
+    double* busy; // seconds each thread spent in the loops, for --stats
+    LocalSearchBuffers search; // buffers of --optimize
+} ParallelFarthestWorkspace;
+
+// Build a tour of the prepared problem with the workspace's buffers, improve it with
+// problem->options.optimize, and leave it in the workspace's order with the problem's
+// vertex ids, in the order the command-line solver writes it. 0 on success and -1 on failure.
+// The OpenMP constructions share each step between the threads and build one tour from
+// vertex 0, without --starts or --partition.
+int cheapestInsertionTour(const TspProblem* problem, CheapestWorkspace* workspace);
+int farthestInsertionTour(const TspProblem* problem, FarthestWorkspace* workspace);
+int parallelCheapestInsertionTour(const TspProblem* problem, ParallelCheapestWorkspace* workspace);
+int parallelFarthestInsertionTour(const TspProblem* problem, ParallelFarthestWorkspace* workspace);
+
+// Release the buffers a construction left in its workspace
+void releaseCheapestWorkspace(void* workspace);
+void releaseFarthestWorkspace(void* workspace);
+void releaseParallelCheapestWorkspace(void* workspace);
+void releaseParallelFarthestWorkspace(void* workspace);
+
+typedef enum {
+    SOLVE_CHEAPEST_INSERTION,
+    SOLVE_FARTHEST_INSERTION,
+    SOLVE_PARALLEL_CHEAPEST_INSERTION,
+    SOLVE_PARALLEL_FARTHEST_INSERTION
+} SolveMethod;
+
+// Everything a solve needs, kept between solves. Once a context has solved its
+// largest instance with a set of options, further solves with them allocate nothing.
+// A zeroed context is empty.
+typedef struct {
+    TspProblem* problem; // the coordinates of the last solve and their tables
+    CheapestWorkspace cheapest;
+    FarthestWorkspace farthest;
+    ParallelCheapestWorkspace parallelCheapest;
+    ParallelFarthestWorkspace parallelFarthest;
+} SolveContext;
+
+// Solve the instance of numOfCoords points (x[i], y[i]) with the method and options,
+// which defaultOptions() fills in, and write the tour into order[0 .. numOfCoords - 1]
+// as indices of the points. 0 on success and -1 on failure, which is named on stderr.
+int solveTour(SolveContext* context, SolveMethod method, const double* x, const double* y, int numOfCoords,
+              const TspOptions* options, int* order);
+
+// Free everything the context holds, leaving it empty
+void releaseSolveContext(SolveContext* context);
+
+#endif
@@ -0,0 +1,379 @@
+// tspTour.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "tspProblem.h"
+#include "tspTour.h"
+
+#define LABEL_BITS 62 // labels lie strictly between 0 and 2^62, which stand for the tour's ends
+#define LABEL_LIMIT ((uint64_t)1 << LABEL_BITS)
+
+TspTour* createTour(int capacity, int withOrderIndex) {
+    TspTour* tour = calloc(1, sizeof(TspTour));
+    if (!tour) {
+        perror("Memory allocation for tour failed");
+        return NULL;
+    }
+
+    tour->capacity = capacity;
+    tour->head = -1;
+    tour->next = malloc(capacity * sizeof(int));
+    tour->prev = malloc(capacity * sizeof(int));
+    if (withOrderIndex) {
+        tour->label = malloc(capacity * sizeof(uint64_t));
+    }
+    if (!tour->next || !tour->prev || (withOrderIndex && !tour->label)) {
+        perror("Memory allocation for tour failed");
+        freeTour(tour);
+        return NULL;
+    }
+    return tour;
+}
+
+void freeTour(TspTour* tour) {
+    if (!tour) {
+        return;
+    }
+    free(tour->next);
+    free(tour->prev);
+    free(tour->label);
+    free(tour);
+}
+
+void startTour(TspTour* tour, int v) {
+    tour->head = v;
+    tour->next[v] = v;
+    tour->prev[v] = v;
+    tour->size = 1;
+    if (tour->label) {
+        tour->label[v] = LABEL_LIMIT / 2;
+    }
+}
+
+// Spread the labels around anchor evenly over the smallest aligned label range
+// that is sparse enough, which opens a gap on both sides of anchor. The allowed
+// density shrinks by 3/4 per doubling of the range, so relabelling costs
+// amortised O(log^2 n) per insertion.
+static void relabel(TspTour* tour, int anchor) {
+    double allowed = 1.0;
+    for (int bits = 1; bits <= LABEL_BITS; bits++) {
+        allowed *= 4.0 / 3.0;
+        uint64_t width = (uint64_t)1 << bits;
+        uint64_t base = tour->label[anchor] & ~(width - 1);
+
+        // Labels increase along the tour, so the range covers a contiguous run
+        int first = anchor;
+        int count = 1;
+        while (first != tour->head && tour->label[tour->prev[first]] >= base) {
+            first = tour->prev[first];
+            count++;
+        }
+        int last = anchor;
+        while (tour->next[last] != tour->head && tour->label[tour->next[last]] - base < width) {
+            last = tour->next[last];
+            count++;
+        }
+
+        if (bits == LABEL_BITS || (count + 2 <= allowed && (uint64_t)count + 2 <= width / 2)) {
+            uint64_t gap = width / (count + 1);
+            int v = first;
+            for (int k = 1; k <= count; k++) {
+                tour->label[v] = base + gap * k;
+                v = tour->next[v];
+            }
+            return;
+        }
+    }
+}
+
+// Give v a label between left and right, -1 standing for the start or end of the tour
+static void assignLabel(TspTour* tour, int left, int right, int v) {
+    uint64_t low = left < 0 ? 0 : tour->label[left];
+    uint64_t high = right < 0 ? LABEL_LIMIT : tour->label[right];
+    if (high - low < 2) {
+        relabel(tour, left >= 0 ? left : right);
+        low = left < 0 ? 0 : tour->label[left];
+        high = right < 0 ? LABEL_LIMIT : tour->label[right];
+    }
+    tour->label[v] = low + (high - low) / 2;
+}
+
+void insertAfter(TspTour* tour, int from, int v) {
+    int to = tour->next[from];
+    if (tour->label) {
+        assignLabel(tour, from, to == tour->head ? -1 : to, v);
+    }
+
+    tour->next[v] = to;
+    tour->prev[v] = from;
+    tour->prev[to] = v;
+    tour->next[from] = v;
+    tour->size++;
+}
+
+void insertBefore(TspTour* tour, int to, int v) {
+    int from = tour->prev[to];
+    if (tour->label) {
+        assignLabel(tour, to == tour->head ? -1 : from, to, v);
+    }
+
+    tour->next[v] = to;
+    tour->prev[v] = from;
+    tour->prev[to] = v;
+    tour->next[from] = v;
+    tour->size++;
+    if (to == tour->head) {
+        tour->head = v;
+    }
+}
+
+void tourToArray(const TspTour* tour, int* order) {
+    int v = tour->head;
+    for (int i = 0; i < tour->size; i++) {
+        order[i] = v;
+        v = tour->next[v];
+    }
+}
+
+void setTourOrder(TspTour* tour, const int* order, int count) {
+    tour->head = order[0];
+    tour->size = count;
+    for (int i = 0; i < count; i++) {
+        tour->next[order[i]] = order[(i + 1) % count];
+        tour->prev[order[(i + 1) % count]] = order[i];
+    }
+    if (tour->label) {
+        // Spread evenly, leaving room at both ends for later insertions
+        uint64_t gap = LABEL_LIMIT / ((uint64_t)count + 1);
+        for (int i = 0; i < count; i++) {
+            tour->label[order[i]] = gap * (i + 1);
+        }
+    }
+}
+
+void copyTour(TspTour* to, const TspTour* from, int numOfCoords) {
+    to->size = from->size;
+    to->head = from->head;
+    memcpy(to->next, from->next, numOfCoords * sizeof(int));
+    memcpy(to->prev, from->prev, numOfCoords * sizeof(int));
+    if (to->label && from->label) {
+        memcpy(to->label, from->label, numOfCoords * sizeof(uint64_t));
+    }
+}
+
+// Whether the file starts with the binary tour magic
+static int isBinaryTour(const char* filename) {
+    FILE* file = fopen(filename, "rb");
+    uint32_t magic = 0;
+    int binary = file && fread(&magic, sizeof(magic), 1, file) == 1 && magic == BINARY_TOUR_MAGIC;
+    if (file) {
+        fclose(file);
+    }
+    return binary;
+}
+
+// Mark vertex v of the tour in filename as seen, 0 if it is a vertex not seen before
+// and -1, naming the problem, otherwise
+static int visitOnce(const char* filename, int numOfCoords, char* seen, long v) {
+    if (v < 0 || v >= numOfCoords) {
+        fprintf(stderr, "Error: %s visits %ld, which is not a vertex 0 .. %d\n", filename, v, numOfCoords - 1);
+        return -1;
+    }
+    if (seen[v]) {
+        fprintf(stderr, "Error: %s visits vertex %ld twice\n", filename, v);
+        return -1;
+    }
+    seen[v] = 1;
+    return 0;
+}
+
+// Copy a binary tour out of its mapped file, checking it visits every vertex once
+static int readBinaryTour(const char* filename, int numOfCoords, int* order) {
+    size_t size;
+    int mapped;
+    void* data = mapInputFile(filename, &size, &mapped);
+    if (!data) {
+        return -1;
+    }
+
+    BinaryHeader header;
+    int status = checkBinaryHeader(data, size, filename, BINARY_TOUR_MAGIC, &header);
+    if (status == 0 && header.elementType != ELEMENT_U32) {
+        fprintf(stderr, "Error: %s does not hold u32 vertex ids\n", filename);
+        status = -1;
+    } else if (status == 0 && header.count != (uint64_t)numOfCoords) {
+        fprintf(stderr, "Error: %s visits %llu vertices, not %d\n", filename, (unsigned long long)header.count, numOfCoords);
+        status = -1;
+    }
+    char* seen = status == 0 ? calloc(numOfCoords, sizeof(char)) : NULL;
+    if (status == 0 && !seen) {
+        perror("Memory allocation for tour failed");
+        status = -1;
+    }
+    const char* payload = (const char*)data + sizeof(BinaryHeader);
+    for (int i = 0; status == 0 && i < numOfCoords; i++) {
+        uint32_t v;
+        memcpy(&v, payload + i * sizeof(uint32_t), sizeof(v));
+        status = visitOnce(filename, numOfCoords, seen, (long)v);
+        order[i] = (int)v;
+    }
+
+    free(seen);
+    releaseInputFile(data, size, mapped);
+    return status;
+}
+
+static inline int isTourSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+// Every id of a text tour in a new array, *count of them, NULL on failure. The file is
+// split into blank-separated words and words that are not whole integers are skipped,
+// so headers and notes between the ids do not matter.
+static long* readTextIds(const char* filename, long* count) {
+    size_t size;
+    int mapped;
+    char* data = mapInputFile(filename, &size, &mapped);
+    if (!data) {
+        return NULL;
+    }
+    // Each id takes at least a digit and a blank
+    long* ids = malloc((size / 2 + 1) * sizeof(long));
+    if (!ids) {
+        perror("Memory allocation for tour failed");
+        releaseInputFile(data, size, mapped);
+        return NULL;
+    }
+
+    long found = 0;
+    const char* p = data;
+    const char* end = data + size;
+    while (p < end) {
+        while (p < end && isTourSpace(*p)) {
+            p++;
+        }
+        int negative = p < end && *p == '-';
+        if (p < end && (*p == '-' || *p == '+')) {
+            p++;
+        }
+        const char* digits = p;
+        long id = 0;
+        while (p < end && *p >= '0' && *p <= '9') {
+            // Ids too large for any tour saturate rather than overflow
+            id = id < (1L << 40) ? id * 10 + (*p - '0') : id;
+            p++;
+        }
+        int whole = p > digits && (p == end || isTourSpace(*p));
+        while (p < end && !isTourSpace(*p)) {
+            p++;
+        }
+        if (whole) {
+            ids[found++] = negative ? -id : id;
+        }
+    }
+    releaseInputFile(data, size, mapped);
+    *count = found;
+    return ids;
+}
+
+int readTourFile(const char* filename, int numOfCoords, int* order) {
+    if (isBinaryTour(filename)) {
+        return readBinaryTour(filename, numOfCoords, order);
+    }
+
+    long count;
+    long* ids = readTextIds(filename, &count);
+    if (!ids) {
+        return -1;
+    }
+    char* seen = calloc(numOfCoords, sizeof(char));
+    if (!seen) {
+        perror("Memory allocation for tour failed");
+        free(ids);
+        return -1;
+    }
+
+    // Drop the count line and the closing vertex when the file has them
+    int offset = (count == (long)numOfCoords + 2 && ids[0] == numOfCoords + 1) ? 1 : 0;
+    long length = count - offset;
+    if (length == (long)numOfCoords + 1 && ids[offset] == ids[offset + numOfCoords]) {
+        length = numOfCoords;
+    }
+
+    int status = 0;
+    if (length != numOfCoords) {
+        fprintf(stderr, "Error: %s visits %ld vertices, not %d\n", filename, length, numOfCoords);
+        status = -1;
+    }
+    for (int i = 0; status == 0 && i < numOfCoords; i++) {
+        long v = ids[offset + i];
+        status = visitOnce(filename, numOfCoords, seen, v);
+        order[i] = (int)v;
+    }
+
+    free(ids);
+    free(seen);
+    return status;
+}
+
+int writeTourFile(const char* filename, const int* order, int numOfCoords) {
+    FILE* file = fopen(filename, "w");
+    if (!file) {
+        perror("Error opening output file");
+        return -1;
+    }
+
+    // Write the count of elements in the tour on the first line, including the return to the start
+    fprintf(file, "%d\n", numOfCoords + 1);
+    for (int i = 0; i < numOfCoords; i++) {
+        fprintf(file, "%d ", order[i]);
+    }
+    fprintf(file, "%d\n", order[0]);
+    int status = ferror(file) ? -1 : 0;
+    if (fclose(file) != 0) {
+        status = -1;
+    }
+    if (status != 0) {
+        perror("Error writing output file");
+    }
+    return status;
+}
+
+int writeBinaryTourFile(const char* filename, const int* order, int numOfCoords) {
+    const void* parts[1] = { order };
+    size_t partSizes[1] = { numOfCoords * sizeof(int) };
+    return writeBinaryFile(filename, BINARY_TOUR_MAGIC, ELEMENT_U32, numOfCoords, parts, partSizes, 1);
+}
+
+int countTourVertices(const char* filename) {
+    if (isBinaryTour(filename)) {
+        BinaryHeader header;
+        FILE* file = fopen(filename, "rb");
+        int ok = file && fread(&header, sizeof(header), 1, file) == 1 && header.count <= INT32_MAX;
+        if (file) {
+            fclose(file);
+        }
+        return ok ? (int)header.count : -1;
+    }
+
+    long count;
+    long* ids = readTextIds(filename, &count);
+    if (!ids) {
+        return -1;
+    }
+    long firstId = count >= 1 ? ids[0] : -1;
+    long secondId = count >= 2 ? ids[1] : -1;
+    long lastId = count >= 1 ? ids[count - 1] : -1;
+    free(ids);
+
+    // A count line can only come first when the tour is closed, and then it is the
+    // number of ids after it; a tour without one is closed if it ends where it starts
+    if (count >= 3 && firstId == count - 1 && secondId == lastId) {
+        return (int)(count - 2);
+    }
+    if (count >= 2 && firstId == lastId) {
+        return (int)(count - 1);
+    }
+    return (int)count;
+}
@@ -0,0 +1,64 @@
+// tspTour.h
+// Tour container with O(1) insertion shared by the solvers. Build it into each
+// binary next to tspProblem.c, e.g. gcc cInsertion.c cheapestInsertion.c batch.c tspProblem.c tspTour.c twoLevelList.c localSearch.c -o cInsertion -lm
+#ifndef TSP_TOUR_H
+#define TSP_TOUR_H
+
+#include <stdint.h>
+#include "tspProblem.h"
+
+typedef struct {
+    int capacity; // largest vertex id + 1
+    int size; // number of vertices in the tour
+    int head; // first vertex of the tour in output order
+    int* next; // successor of each vertex in the tour, the tail's is the head
+    int* prev; // predecessor of each vertex in the tour, the head's is the tail
+    uint64_t* label; // order labels increasing from the head, NULL without the order index
+} TspTour;
+
+// Allocate an empty tour over vertices 0 .. capacity - 1, NULL on failure.
+// The order index is only needed for tourPrecedes().
+TspTour* createTour(int capacity, int withOrderIndex);
+
+void freeTour(TspTour* tour);
+
+// Start the tour with the single vertex v
+void startTour(TspTour* tour, int v);
+
+// Insert v right after vertex from in output order
+void insertAfter(TspTour* tour, int from, int v);
+
+// Insert v right before vertex to in output order, v becomes the head if to was
+void insertBefore(TspTour* tour, int to, int v);
+
+// Write the tour into order[0 .. size - 1] starting from the head
+void tourToArray(const TspTour* tour, int* order);
+
+// Replace the tour with order[0 .. count - 1], order[0] becomes the head
+void setTourOrder(TspTour* tour, const int* order, int count);
+
+// Make to the same tour as from, both over vertices 0 .. numOfCoords - 1. The order
+// index is copied when both have one.
+void copyTour(TspTour* to, const TspTour* from, int numOfCoords);
+
+// Read a tour over vertices 0 .. numOfCoords - 1 into order, 0 on success and -1
+// if the file is not a permutation, whose first wrong vertex is named on stderr.
+// Accepts a binary tour, a count line followed by the tour closed at its start, or
+// one vertex per line; words that are not ids are skipped.
+int readTourFile(const char* filename, int numOfCoords, int* order);
+
+// Number of vertices of the tour in a file, found from its layout, -1 on failure
+int countTourVertices(const char* filename);
+
+// Write a count line and the tour closed at its start, 0 on success and -1 on failure
+int writeTourFile(const char* filename, const int* order, int numOfCoords);
+
+// Write order[0 .. numOfCoords - 1] as a binary tour, 0 on success and -1 on failure
+int writeBinaryTourFile(const char* filename, const int* order, int numOfCoords);
+
+// Whether a comes before b in output order, needs the order index
+static inline int tourPrecedes(const TspTour* tour, int a, int b) {
+    return tour->label[a] < tour->label[b];
+}
+
+#endif
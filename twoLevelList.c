@@ -0,0 +1,347 @@
+// twoLevelList.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "twoLevelList.h"
+
+#define MIN_GROUP_SIZE 8
+
+TwoLevelList* createTwoLevelList(int capacity) {
+    TwoLevelList* list = calloc(1, sizeof(TwoLevelList));
+    if (!list) {
+        perror("Memory allocation for two-level list failed");
+        return NULL;
+    }
+    if (resizeTwoLevelList(list, capacity) != 0) {
+        freeTwoLevelList(list);
+        return NULL;
+    }
+    return list;
+}
+
+// Free the list's buffers and forget their sizes
+static void releaseBuffers(TwoLevelList* list) {
+    free(list->parent);
+    free(list->seq);
+    free(list->inNext);
+    free(list->inPrev);
+    free(list->first);
+    free(list->last);
+    free(list->count);
+    free(list->segNext);
+    free(list->segPrev);
+    free(list->rank);
+    free(list->reversed);
+    free(list->scratch);
+    memset(list, 0, sizeof(TwoLevelList));
+}
+
+int resizeTwoLevelList(TwoLevelList* list, int capacity) {
+    int groupSize = (int)sqrt((double)capacity);
+    if (groupSize < MIN_GROUP_SIZE) {
+        groupSize = MIN_GROUP_SIZE;
+    }
+    // Room for the rebuilt segments, and as many again for splits before the next rebuild
+    int segments = 2 * (capacity / groupSize) + 8;
+
+    if (capacity > list->vertexSlots || segments > list->segmentSlots) {
+        int vertices = capacity > list->vertexSlots ? capacity : list->vertexSlots;
+        segments = segments > list->segmentSlots ? segments : list->segmentSlots;
+        releaseBuffers(list);
+        list->parent = malloc(vertices * sizeof(int));
+        list->seq = malloc(vertices * sizeof(int));
+        list->inNext = malloc(vertices * sizeof(int));
+        list->inPrev = malloc(vertices * sizeof(int));
+        list->first = malloc(segments * sizeof(int));
+        list->last = malloc(segments * sizeof(int));
+        list->count = malloc(segments * sizeof(int));
+        list->segNext = malloc(segments * sizeof(int));
+        list->segPrev = malloc(segments * sizeof(int));
+        list->rank = malloc(segments * sizeof(int));
+        list->reversed = malloc(segments * sizeof(unsigned char));
+        list->scratch = malloc((vertices + 2 * (size_t)segments) * sizeof(int));
+        if (!list->parent || !list->seq || !list->inNext || !list->inPrev || !list->first || !list->last ||
+            !list->count || !list->segNext || !list->segPrev || !list->rank || !list->reversed || !list->scratch) {
+            perror("Memory allocation for two-level list failed");
+            releaseBuffers(list);
+            return -1;
+        }
+        list->vertexSlots = vertices;
+        list->segmentSlots = segments;
+    }
+
+    // Sized for the capacity alone, so a reused list behaves like a new one
+    list->capacity = capacity;
+    list->groupSize = groupSize;
+    list->maxSegments = 2 * (capacity / groupSize) + 8;
+    list->size = 0;
+    list->numSegments = 0;
+    return 0;
+}
+
+void freeTwoLevelList(TwoLevelList* list) {
+    if (!list) {
+        return;
+    }
+    releaseBuffers(list);
+    free(list);
+}
+
+void startTwoLevelList(TwoLevelList* list, int v) {
+    setTwoLevelOrder(list, &v, 1);
+}
+
+void setTwoLevelOrder(TwoLevelList* list, const int* order, int count) {
+    int segments = (count + list->groupSize - 1) / list->groupSize;
+    list->size = count;
+    list->numSegments = segments;
+
+    // Cut the tour into segments of equal length, give or take one
+    for (int s = 0; s < segments; s++) {
+        int begin = (int)((int64_t)count * s / segments);
+        int end = (int)((int64_t)count * (s + 1) / segments);
+        for (int i = begin; i < end; i++) {
+            int v = order[i];
+            list->parent[v] = s;
+            list->seq[v] = i - begin;
+            list->inPrev[v] = i == begin ? -1 : order[i - 1];
+            list->inNext[v] = i == end - 1 ? -1 : order[i + 1];
+        }
+        list->first[s] = order[begin];
+        list->last[s] = order[end - 1];
+        list->count[s] = end - begin;
+        list->segNext[s] = s + 1 == segments ? 0 : s + 1;
+        list->segPrev[s] = s == 0 ? segments - 1 : s - 1;
+        list->rank[s] = s;
+        list->reversed[s] = 0;
+    }
+}
+
+// Cut the segments evenly again once splits have used up the spare segments
+static void rebuild(TwoLevelList* list) {
+    int* order = list->scratch;
+    int v = list->reversed[0] ? list->last[0] : list->first[0];
+    twoLevelToArray(list, v, order);
+    setTwoLevelOrder(list, order, list->size);
+}
+
+// Renumber the segment ranks around the cycle starting from segment s
+static void renumberRanks(TwoLevelList* list, int s) {
+    int t = s;
+    for (int r = 0; r < list->numSegments; r++) {
+        list->rank[t] = r;
+        t = list->segNext[t];
+    }
+}
+
+// Make v the first vertex of its segment in tour direction. The shorter side of the
+// cut moves to a new segment, so callers must leave room for one more.
+static void splitBefore(TwoLevelList* list, int v) {
+    int s = list->parent[v];
+    int reversed = list->reversed[s];
+    if (v == (reversed ? list->last[s] : list->first[s])) {
+        return;
+    }
+
+    // Cut the segment's own list between u and w into first .. u and w .. last
+    int u = reversed ? v : list->inPrev[v];
+    int w = reversed ? list->inNext[v] : v;
+    int leftCount = list->seq[u] - list->seq[list->first[s]] + 1;
+    int rightCount = list->count[s] - leftCount;
+    int moveLeft = leftCount <= rightCount;
+
+    int t = list->numSegments++;
+    int from = moveLeft ? list->first[s] : w;
+    int to = moveLeft ? u : list->last[s];
+    for (int x = from;; x = list->inNext[x]) {
+        list->parent[x] = t;
+        if (x == to) {
+            break;
+        }
+    }
+    list->first[t] = from;
+    list->last[t] = to;
+    list->count[t] = moveLeft ? leftCount : rightCount;
+    list->reversed[t] = reversed;
+    if (moveLeft) {
+        list->first[s] = w;
+    } else {
+        list->last[s] = u;
+    }
+    list->count[s] -= list->count[t];
+    list->inNext[u] = -1;
+    list->inPrev[w] = -1;
+
+    // The left part comes first in tour direction unless the segment is reversed
+    if (moveLeft != reversed) {
+        int before = list->segPrev[s];
+        list->segNext[before] = t;
+        list->segPrev[t] = before;
+        list->segNext[t] = s;
+        list->segPrev[s] = t;
+    } else {
+        int after = list->segNext[s];
+        list->segNext[s] = t;
+        list->segPrev[t] = s;
+        list->segNext[t] = after;
+        list->segPrev[after] = t;
+    }
+    renumberRanks(list, s);
+}
+
+void twoLevelInsertAfter(TwoLevelList* list, int from, int v) {
+    if (list->numSegments == list->maxSegments) {
+        rebuild(list);
+    }
+
+    int s = list->parent[from];
+    list->parent[v] = s;
+    if (list->reversed[s]) {
+        // Before from in the segment's own order
+        int before = list->inPrev[from];
+        list->inPrev[v] = before;
+        list->inNext[v] = from;
+        list->inPrev[from] = v;
+        if (before < 0) {
+            list->first[s] = v;
+        } else {
+            list->inNext[before] = v;
+        }
+    } else {
+        int after = list->inNext[from];
+        list->inNext[v] = after;
+        list->inPrev[v] = from;
+        list->inNext[from] = v;
+        if (after < 0) {
+            list->last[s] = v;
+        } else {
+            list->inPrev[after] = v;
+        }
+    }
+    list->count[s]++;
+    list->size++;
+
+    int seq = 0;
+    int middle = -1;
+    for (int x = list->first[s]; x >= 0; x = list->inNext[x]) {
+        list->seq[x] = seq++;
+        if (seq == list->count[s] / 2 + 1) {
+            middle = x;
+        }
+    }
+
+    // Halve segments that grew to twice the group size
+    if (list->count[s] >= 2 * list->groupSize) {
+        splitBefore(list, middle);
+    }
+}
+
+// Reverse the path from b to c in tour direction inside their common segment s
+static void reverseInside(TwoLevelList* list, int s, int b, int c) {
+    int x = list->reversed[s] ? c : b;
+    int y = list->reversed[s] ? b : c;
+    int before = list->inPrev[x];
+    int after = list->inNext[y];
+    int seqSum = list->seq[x] + list->seq[y];
+
+    for (int v = x;;) {
+        int next = list->inNext[v];
+        list->inNext[v] = list->inPrev[v];
+        list->inPrev[v] = next;
+        list->seq[v] = seqSum - list->seq[v];
+        if (v == y) {
+            break;
+        }
+        v = next;
+    }
+
+    list->inPrev[y] = before;
+    if (before < 0) {
+        list->first[s] = y;
+    } else {
+        list->inNext[before] = y;
+    }
+    list->inNext[x] = after;
+    if (after < 0) {
+        list->last[s] = x;
+    } else {
+        list->inPrev[after] = x;
+    }
+}
+
+// Reverse the run of whole segments from first to last in tour direction
+static void reverseSegments(TwoLevelList* list, int first, int last) {
+    int* run = list->scratch;
+    int* ranks = list->scratch + list->maxSegments;
+    int k = 0;
+    for (int s = first;; s = list->segNext[s]) {
+        run[k] = s;
+        ranks[k++] = list->rank[s];
+        if (s == last) {
+            break;
+        }
+    }
+
+    int before = list->segPrev[first];
+    int after = list->segNext[last];
+    list->segNext[before] = last;
+    list->segPrev[last] = before;
+    for (int i = k - 1; i > 0; i--) {
+        list->segNext[run[i]] = run[i - 1];
+        list->segPrev[run[i - 1]] = run[i];
+    }
+    list->segNext[first] = after;
+    list->segPrev[after] = first;
+
+    // The run keeps its place in the cycle, so its ranks are handed out again backwards
+    for (int i = 0; i < k; i++) {
+        list->rank[run[k - 1 - i]] = ranks[i];
+        list->reversed[run[i]] ^= 1;
+    }
+}
+
+// Whether the path from b to c in tour direction lies inside one segment
+static inline int withinSegment(const TwoLevelList* list, int b, int c) {
+    return list->parent[b] == list->parent[c] && twoLevelKey(list, b) <= twoLevelKey(list, c);
+}
+
+void twoLevelReverse(TwoLevelList* list, int b, int c) {
+    int a = twoLevelPrev(list, b);
+    int d = twoLevelNext(list, c);
+    if (b == c || d == b) {
+        return; // A single vertex or the whole tour, the cycle stays the same
+    }
+    if (withinSegment(list, b, c)) {
+        reverseInside(list, list->parent[b], b, c);
+        return;
+    }
+    if (withinSegment(list, d, a)) {
+        reverseInside(list, list->parent[d], d, a);
+        return;
+    }
+
+    // Align the path with segment boundaries, then reverse the shorter run of segments
+    if (list->numSegments + 2 > list->maxSegments) {
+        rebuild(list);
+    }
+    splitBefore(list, b);
+    splitBefore(list, d);
+    int runLength = list->rank[list->parent[c]] - list->rank[list->parent[b]];
+    if (runLength < 0) {
+        runLength += list->numSegments;
+    }
+    if (2 * (runLength + 1) <= list->numSegments) {
+        reverseSegments(list, list->parent[b], list->parent[c]);
+    } else {
+        reverseSegments(list, list->parent[d], list->parent[a]);
+    }
+}
+
+void twoLevelToArray(const TwoLevelList* list, int start, int* order) {
+    int v = start;
+    for (int i = 0; i < list->size; i++) {
+        order[i] = v;
+        v = twoLevelNext(list, v);
+    }
+}
@@ -0,0 +1,111 @@
+// twoLevelList.h
+// Tour as a two-level doubly-linked list: the vertices are split into about sqrt(n)
+// segments, each a linked list with a reversal bit, and the segments form a cycle.
+// next, prev and between take O(1) and reversing a path O(sqrt(n)), so local search
+// on large tours does not pay O(n) per move as it does on an array. Build it into a
+// binary next to tspTour.c, e.g. gcc cInsertion.c cheapestInsertion.c batch.c tspProblem.c tspTour.c twoLevelList.c localSearch.c -o cInsertion -lm
+#ifndef TWO_LEVEL_LIST_H
+#define TWO_LEVEL_LIST_H
+
+#include <stdint.h>
+
+typedef struct {
+    int capacity; // largest vertex id + 1
+    int size; // number of vertices in the tour
+    int groupSize; // segment length the list is rebuilt with, about sqrt(capacity)
+    int numSegments;
+    int maxSegments; // splits beyond this rebuild the segments evenly
+
+    // Per vertex, in the segment's own order which the reversal bit may flip
+    int* parent; // segment holding the vertex
+    int* seq; // consecutive numbers increasing along inNext within the segment
+    int* inNext; // -1 at the segment's last vertex
+    int* inPrev; // -1 at the segment's first vertex
+
+    // Per segment, segNext and rank follow the tour direction
+    int* first;
+    int* last;
+    int* count;
+    int* segNext;
+    int* segPrev;
+    int* rank; // consecutive around the cycle of segments
+    unsigned char* reversed; // the tour runs from last to first through this segment
+
+    int* scratch; // capacity vertices, or maxSegments segments, while rebuilding or reversing
+    int vertexSlots, segmentSlots; // sizes of the buffers, which only grow
+} TwoLevelList;
+
+// Allocate an empty list over vertices 0 .. capacity - 1, NULL on failure
+TwoLevelList* createTwoLevelList(int capacity);
+
+// Make a list from createTwoLevelList(), or a zeroed one, an empty list over vertices
+// 0 .. capacity - 1, reusing its buffers when they are large enough. 0 on success and
+// -1 on failure, which leaves it empty with no buffers.
+int resizeTwoLevelList(TwoLevelList* list, int capacity);
+
+void freeTwoLevelList(TwoLevelList* list);
+
+// Start the tour with the single vertex v
+void startTwoLevelList(TwoLevelList* list, int v);
+
+// Replace the tour with order[0 .. count - 1]
+void setTwoLevelOrder(TwoLevelList* list, const int* order, int count);
+
+// Insert v right after vertex from in tour direction
+void twoLevelInsertAfter(TwoLevelList* list, int from, int v);
+
+// Reverse the path running from b to c in tour direction. The rest of the tour is
+// reversed instead when that is cheaper, which gives the same cycle but may turn
+// the tour direction around.
+void twoLevelReverse(TwoLevelList* list, int b, int c);
+
+// Write the tour into order[0 .. size - 1] starting from vertex start
+void twoLevelToArray(const TwoLevelList* list, int start, int* order);
+
+// Successor of v in tour direction
+static inline int twoLevelNext(const TwoLevelList* list, int v) {
+    int s = list->parent[v];
+    if (list->reversed[s]) {
+        if (v != list->first[s]) {
+            return list->inPrev[v];
+        }
+    } else if (v != list->last[s]) {
+        return list->inNext[v];
+    }
+    int t = list->segNext[s];
+    return list->reversed[t] ? list->last[t] : list->first[t];
+}
+
+// Predecessor of v in tour direction
+static inline int twoLevelPrev(const TwoLevelList* list, int v) {
+    int s = list->parent[v];
+    if (list->reversed[s]) {
+        if (v != list->last[s]) {
+            return list->inNext[v];
+        }
+    } else if (v != list->first[s]) {
+        return list->inPrev[v];
+    }
+    int t = list->segPrev[s];
+    return list->reversed[t] ? list->first[t] : list->last[t];
+}
+
+// Place of v along the tour, from the segment with rank 0 onwards
+static inline int64_t twoLevelKey(const TwoLevelList* list, int v) {
+    int s = list->parent[v];
+    int64_t within = list->reversed[s] ? (int64_t)list->capacity - list->seq[v] : (int64_t)list->capacity + list->seq[v];
+    return (int64_t)list->rank[s] * (2 * (int64_t)list->capacity + 1) + within;
+}
+
+// Whether b lies on the path running from a to c in tour direction, ends included
+static inline int twoLevelBetween(const TwoLevelList* list, int a, int b, int c) {
+    int64_t ka = twoLevelKey(list, a);
+    int64_t kb = twoLevelKey(list, b);
+    int64_t kc = twoLevelKey(list, c);
+    if (ka <= kc) {
+        return ka <= kb && kb <= kc;
+    }
+    return kb >= ka || kb <= kc;
+}
+
+#endif
@@ -0,0 +1,130 @@
+// validateTour.c
+// Check that tour files visit every vertex of a coordinate file once and print their
+// exact lengths. Any tour format the solvers write is accepted, so the outputs of
+// different solvers can be compared. Options such as --metric may follow the file
+// names. Build with
+// gcc validateTour.c tspProblem.c tspTour.c -o validateTour -lm
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "tspProblem.h"
+#include "tspTour.h"
+
+// Function prototypes
+static int sameCycle(const int* a, const int* b, int numOfCoords, int* successor);
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        printf("Usage: %s <coordinate_file_name> <tour_file_name> [<tour_file_name> ...] [--metric=NAME]\n", argv[0]);
+        printf("Prints \"<tour_file_name> ok <length> <percent_above_shortest>\" for each valid tour,\n");
+        printf("\"<tour_file_name> invalid\" for the others, and \"<tour_file_name> same <tour_file_name>\"\n");
+        printf("for a tour that is an earlier one from another start or direction.\n");
+        return 1;
+    }
+
+    const char* inputFilename = argv[1];
+    int numTours = 0;
+    char** tourFilenames = argv + 2;
+    while (2 + numTours < argc && strncmp(argv[2 + numTours], "--", 2) != 0) {
+        numTours++;
+    }
+
+    // Only the coordinates are needed, the lengths never read a distance table
+    TspOptions options;
+    if (numTours == 0 || parseOptions(argc - 2 - numTours, argv + 2 + numTours, &options) != 0) {
+        printOptionsUsage();
+        return EXIT_FAILURE;
+    }
+    options.distanceMode = DISTANCES_NONE;
+    options.useFloat = 0;
+    options.numNeighbors = 0;
+    options.hilbertOrder = 0;
+    options.partitionSize = 0;
+    TspProblem* problem = readCoordinates(inputFilename);
+    if (!problem) {
+        return EXIT_FAILURE;
+    }
+    if (prepareDistances(problem, &options) != 0) {
+        freeProblem(problem);
+        return EXIT_FAILURE;
+    }
+    int numOfCoords = problem->numOfCoords;
+
+    int** orders = calloc(numTours, sizeof(int*));
+    double* lengths = malloc(numTours * sizeof(double));
+    int* successor = malloc(numOfCoords * sizeof(int));
+    if (!orders || !lengths || !successor) {
+        perror("Memory allocation for tours failed");
+        free(orders);
+        free(lengths);
+        free(successor);
+        freeProblem(problem);
+        return EXIT_FAILURE;
+    }
+
+    int invalid = 0;
+    double shortest = -1.0;
+    for (int t = 0; t < numTours; t++) {
+        orders[t] = malloc(numOfCoords * sizeof(int));
+        if (!orders[t]) {
+            perror("Memory allocation for tour failed");
+        } else if (readTourFile(tourFilenames[t], numOfCoords, orders[t]) != 0) {
+            free(orders[t]);
+            orders[t] = NULL;
+        }
+        if (!orders[t]) {
+            invalid++;
+            continue;
+        }
+        lengths[t] = tourLength(problem, orders[t]);
+        if (shortest < 0.0 || lengths[t] < shortest) {
+            shortest = lengths[t];
+        }
+    }
+
+    for (int t = 0; t < numTours; t++) {
+        if (!orders[t]) {
+            printf("%s invalid\n", tourFilenames[t]);
+            continue;
+        }
+        // Tours as long as the shortest are 0 above it, also when both are inf
+        double above = shortest > 0.0 && lengths[t] > shortest ? 100.0 * (lengths[t] - shortest) / shortest : 0.0;
+        printf("%s ok %.6f %.4f\n", tourFilenames[t], lengths[t], above);
+    }
+
+    // Name each tour after the first valid one it repeats
+    for (int t = 1; t < numTours; t++) {
+        for (int u = 0; orders[t] && u < t; u++) {
+            if (orders[u] && sameCycle(orders[u], orders[t], numOfCoords, successor)) {
+                printf("%s same %s\n", tourFilenames[t], tourFilenames[u]);
+                break;
+            }
+        }
+    }
+
+    for (int t = 0; t < numTours; t++) {
+        free(orders[t]);
+    }
+    free(orders);
+    free(lengths);
+    free(successor);
+    freeProblem(problem);
+    return invalid == 0 ? 0 : EXIT_FAILURE;
+}
+
+// Whether tour b follows the edges of tour a, forwards or backwards from any start.
+// successor is scratch space for numOfCoords vertices.
+static int sameCycle(const int* a, const int* b, int numOfCoords, int* successor) {
+    for (int i = 0; i < numOfCoords; i++) {
+        successor[a[i]] = a[(i + 1) % numOfCoords];
+    }
+    int forward = 1;
+    int backward = 1;
+    for (int i = 0; i < numOfCoords && (forward || backward); i++) {
+        int from = b[i];
+        int to = b[(i + 1) % numOfCoords];
+        forward = forward && successor[from] == to;
+        backward = backward && successor[to] == from;
+    }
+    return forward || backward;
+}